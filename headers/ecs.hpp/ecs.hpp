@@ -10,10 +10,13 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <new>
+#include <atomic>
 #include <tuple>
 #include <memory>
 #include <vector>
 #include <limits>
+#include <numeric>
 #include <utility>
 #include <iterator>
 #include <stdexcept>
@@ -21,6 +24,12 @@
 #include <functional>
 #include <type_traits>
 
+#if defined(__has_include)
+#  if __has_include(<memory_resource>)
+#    include <memory_resource>
+#  endif
+#endif
+
 // -----------------------------------------------------------------------------
 //
 // config
@@ -38,6 +47,7 @@ namespace ecs_hpp
     class const_component;
 
     class prototype;
+    class compiled_prototype;
 
     template < typename E >
     class after;
@@ -69,15 +79,30 @@ namespace ecs_hpp
 
     class entity_filler;
     class registry_filler;
+
+    template < typename T >
+    class soa_reference;
+    template < typename T >
+    class soa_pointer;
 }
 
 namespace ecs_hpp
 {
     using family_id = std::uint16_t;
+
+#if defined(ECS_HPP_ENTITY_ID_64)
+    // define ECS_HPP_ENTITY_ID_64 for more than 4M live entities
+    // and for slower wrapping of entity versions
+    using entity_id = std::uint64_t;
+
+    constexpr std::size_t entity_id_index_bits = 40u;
+    constexpr std::size_t entity_id_version_bits = 24u;
+#else
     using entity_id = std::uint32_t;
 
     constexpr std::size_t entity_id_index_bits = 22u;
     constexpr std::size_t entity_id_version_bits = 10u;
+#endif
 
     static_assert(
         std::is_unsigned_v<family_id>,
@@ -92,6 +117,76 @@ namespace ecs_hpp
         entity_id_version_bits > 0u &&
         sizeof(entity_id) == (entity_id_index_bits + entity_id_version_bits) / 8u,
         "ecs_hpp (invalid entity id index and version bits)");
+
+    static_assert(
+        sizeof(entity_id) <= sizeof(std::size_t),
+        "ecs_hpp (entity_id must fit in std::size_t)");
+}
+
+namespace ecs_hpp
+{
+    // components are stored in a dense array of values by default
+    struct dense_storage_policy {};
+
+    // each field of an aggregate component lives in its own dense array
+    struct soa_storage_policy {};
+
+    // components never move in memory while they are alive, so pointers
+    // and references to them stay valid until the component is removed
+    struct stable_storage_policy {};
+
+    // entities refer to reference counted values, so copies made by prototypes
+    // and clones share one instance, components are read-only until detached
+    struct shared_storage_policy {};
+
+    // specialize to customize the storage of a component type:
+    //
+    // template <>
+    // struct ecs_hpp::component_traits<position> {
+    //     using storage_policy = ecs_hpp::soa_storage_policy;
+    // };
+    template < typename T >
+    struct component_traits {};
+
+    enum class registry_backend : std::uint8_t {
+        // every component type has its own sparse storage
+        sparse,
+        // entities with the same set of components share a table of columns,
+        // joins are faster, assigning and removing components are slower
+        archetype
+    };
+
+    enum class growth_mode : std::uint8_t {
+        // the growth of the standard containers, tables are doubled
+        native,
+        // the capacity is doubled
+        doubling,
+        // the capacity grows by a half, less overshoot, more reallocations
+        one_and_half,
+        // the capacity grows by `growth_policy::size` elements
+        fixed_step,
+        // the capacity grows to `growth_policy::size` at once, then doubles
+        reserved
+    };
+
+    struct growth_policy {
+        growth_mode mode{growth_mode::native};
+        std::size_t size{0u};
+    };
+
+    struct growth_event {
+        // the family of the component, zero for the registry tables
+        family_id family{0u};
+        std::size_t element_size{0u};
+        std::size_t old_capacity{0u};
+        std::size_t new_capacity{0u};
+    };
+
+    class growth_observer {
+    public:
+        virtual ~growth_observer() = default;
+        virtual void on_growth(const growth_event& event) noexcept = 0;
+    };
 }
 
 // -----------------------------------------------------------------------------
@@ -174,6 +269,115 @@ namespace ecs_hpp::detail
             v);
     }
 
+    //
+    // uint_least_t
+    //
+
+    template < std::size_t Bits >
+    using uint_least_t =
+        std::conditional_t<Bits <= 8u, std::uint8_t,
+        std::conditional_t<Bits <= 16u, std::uint16_t,
+        std::conditional_t<Bits <= 32u, std::uint32_t,
+        std::uint64_t>>>;
+
+    //
+    // rebind_alloc_t
+    //
+
+    template < typename Allocator, typename T >
+    using rebind_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    //
+    // make_value
+    //
+
+    // arguments are passed to a constructor like emplace does,
+    // aggregates without a matching constructor are brace-initialized
+    template < typename T, typename... Args >
+    T make_value(Args&&... args) {
+        if constexpr ( std::is_constructible_v<T, Args...> ) {
+            return T(std::forward<Args>(args)...);
+        } else {
+            return T{std::forward<Args>(args)...};
+        }
+    }
+
+    template < typename T, typename... Args >
+    T* construct_value(void* p, Args&&... args) {
+        if constexpr ( std::is_constructible_v<T, Args...> ) {
+            return ::new(p) T(std::forward<Args>(args)...);
+        } else {
+            return ::new(p) T{std::forward<Args>(args)...};
+        }
+    }
+
+    template < typename T, typename A, typename... Args >
+    T& emplace_back_value(std::vector<T, A>& values, Args&&... args) {
+        if constexpr ( std::is_constructible_v<T, Args...> ) {
+            return values.emplace_back(std::forward<Args>(args)...);
+        } else {
+            return values.emplace_back(T{std::forward<Args>(args)...});
+        }
+    }
+
+    // a single assignable argument is assigned as is and keeps the value resources
+    template < typename T, typename R, typename U >
+    std::enable_if_t<std::is_assignable_v<R&&, U&&>> assign_value(R&& to, U&& from) {
+        std::forward<R>(to) = std::forward<U>(from);
+    }
+
+    template < typename T, typename R, typename... Args >
+    void assign_value(R&& to, Args&&... args) {
+        std::forward<R>(to) = make_value<T>(std::forward<Args>(args)...);
+    }
+
+    //
+    // repeat_iterator
+    //
+
+    // reads the same value for every position of a range
+    template < typename T >
+    class repeat_iterator final {
+    public:
+        explicit repeat_iterator(const T& value) noexcept
+        : value_(&value) {}
+
+        const T& operator*() const noexcept {
+            return *value_;
+        }
+
+        repeat_iterator& operator++() noexcept {
+            return *this;
+        }
+    private:
+        const T* value_{nullptr};
+    };
+
+    //
+    // lowest_bit_index
+    //
+
+    constexpr inline std::size_t lowest_bit_index(std::uint64_t bits) noexcept {
+        // de Bruijn multiplication, the bits must not be zero
+        constexpr std::uint8_t indices[64] = {
+             0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+            62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+            63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+            46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6};
+        return indices[((bits & (~bits + 1u)) * 0x03f79d71b4cb0a89u) >> 58u];
+    }
+
+    //
+    // bit_count
+    //
+
+    constexpr inline std::size_t bit_count(std::uint64_t bits) noexcept {
+        bits = bits - ((bits >> 1u) & 0x5555555555555555u);
+        bits = (bits & 0x3333333333333333u) + ((bits >> 2u) & 0x3333333333333333u);
+        bits = (bits + (bits >> 4u)) & 0x0f0f0f0f0f0f0f0fu;
+        return static_cast<std::size_t>((bits * 0x0101010101010101u) >> 56u);
+    }
+
     //
     // next_capacity_size
     //
@@ -192,12 +396,44 @@ namespace ecs_hpp::detail
         return std::max(cur_size * 2u, min_size);
     }
 
+    inline std::size_t next_capacity_size(
+        std::size_t cur_size,
+        std::size_t min_size,
+        std::size_t max_size,
+        const growth_policy& growth)
+    {
+        if ( min_size > max_size ) {
+            throw std::length_error("ecs_hpp::next_capacity_size");
+        }
+        switch ( growth.mode ) {
+        case growth_mode::native:
+        case growth_mode::doubling:
+            break;
+        case growth_mode::one_and_half:
+            if ( cur_size >= max_size / 3u * 2u ) {
+                return max_size;
+            }
+            return std::max(cur_size + cur_size / 2u, min_size);
+        case growth_mode::fixed_step:
+            if ( max_size - cur_size <= growth.size ) {
+                return max_size;
+            }
+            return std::max(cur_size + growth.size, min_size);
+        case growth_mode::reserved:
+            if ( min_size <= growth.size ) {
+                return std::min(growth.size, max_size);
+            }
+            break;
+        }
+        return next_capacity_size(cur_size, min_size, max_size);
+    }
+
     //
     // entity_id index/version
     //
 
-    constexpr std::size_t entity_id_index_mask = (1u << entity_id_index_bits) - 1u;
-    constexpr std::size_t entity_id_version_mask = (1u << entity_id_version_bits) - 1u;
+    constexpr entity_id entity_id_index_mask = (entity_id(1u) << entity_id_index_bits) - 1u;
+    constexpr entity_id entity_id_version_mask = (entity_id(1u) << entity_id_version_bits) - 1u;
 
     constexpr inline entity_id entity_id_index(entity_id id) noexcept {
         return id & entity_id_index_mask;
@@ -216,6 +452,219 @@ namespace ecs_hpp::detail
             entity_id_index(id),
             entity_id_version(id) + 1u);
     }
+
+    // dense positions of entity keyed containers never exceed the index mask
+    using entity_id_sparse_index = uint_least_t<entity_id_index_bits>;
+}
+
+// -----------------------------------------------------------------------------
+//
+// memory_resource
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp
+{
+    // the part of std::pmr::memory_resource used by registries and prototypes,
+    // std::pmr itself isn't provided by every supported standard library
+    class memory_resource {
+    public:
+        virtual ~memory_resource() = default;
+
+        void* allocate(
+            std::size_t bytes,
+            std::size_t alignment = alignof(std::max_align_t))
+        {
+            return do_allocate(bytes, alignment);
+        }
+
+        void deallocate(
+            void* p,
+            std::size_t bytes,
+            std::size_t alignment = alignof(std::max_align_t)) noexcept
+        {
+            do_deallocate(p, bytes, alignment);
+        }
+
+        bool is_equal(const memory_resource& other) const noexcept {
+            return this == &other || do_is_equal(other);
+        }
+    private:
+        virtual void* do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+        virtual void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept = 0;
+        virtual bool do_is_equal(const memory_resource& other) const noexcept = 0;
+    };
+
+    memory_resource* new_delete_resource() noexcept;
+
+#if defined(__cpp_lib_memory_resource)
+    class pmr_memory_resource final : public memory_resource {
+    public:
+        explicit pmr_memory_resource(std::pmr::memory_resource* upstream) noexcept
+        : upstream_(upstream) {
+            assert(upstream);
+        }
+
+        std::pmr::memory_resource* upstream() const noexcept {
+            return upstream_;
+        }
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept override {
+            upstream_->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const memory_resource& other) const noexcept override {
+            const auto* o = dynamic_cast<const pmr_memory_resource*>(&other);
+            return o && upstream_->is_equal(*o->upstream_);
+        }
+    private:
+        std::pmr::memory_resource* upstream_{nullptr};
+    };
+#endif
+}
+
+namespace ecs_hpp::detail
+{
+    class new_delete_memory_resource final : public memory_resource {
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            if ( alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) {
+                return ::operator new(bytes);
+            }
+            // over-aligned blocks keep the original pointer right before them
+            void* raw = ::operator new(bytes + alignment + sizeof(void*));
+            const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+            const std::uintptr_t aligned = (first + alignment - 1u) & ~std::uintptr_t(alignment - 1u);
+            void** p = reinterpret_cast<void**>(aligned);
+            p[-1] = raw;
+            return p;
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept override {
+            (void)bytes;
+            if ( alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) {
+                ::operator delete(p);
+            } else {
+                ::operator delete(static_cast<void**>(p)[-1]);
+            }
+        }
+
+        bool do_is_equal(const memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    //
+    // resource_allocator
+    //
+
+    template < typename T >
+    class resource_allocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        using is_always_equal = std::false_type;
+    public:
+        resource_allocator() noexcept
+        : resource_(new_delete_resource()) {}
+
+        resource_allocator(memory_resource* resource) noexcept
+        : resource_(resource) {
+            assert(resource);
+        }
+
+        template < typename U >
+        resource_allocator(const resource_allocator<U>& other) noexcept
+        : resource_(other.resource()) {}
+
+        T* allocate(std::size_t n) {
+            if ( n > std::numeric_limits<std::size_t>::max() / sizeof(T) ) {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* p, std::size_t n) noexcept {
+            resource_->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        memory_resource* resource() const noexcept {
+            return resource_;
+        }
+    private:
+        memory_resource* resource_{nullptr};
+    };
+
+    template < typename T, typename U >
+    bool operator==(const resource_allocator<T>& l, const resource_allocator<U>& r) noexcept {
+        return l.resource()->is_equal(*r.resource());
+    }
+
+    template < typename T, typename U >
+    bool operator!=(const resource_allocator<T>& l, const resource_allocator<U>& r) noexcept {
+        return !(l == r);
+    }
+
+    //
+    // resource_uptr
+    //
+
+    class resource_deleter final {
+    public:
+        resource_deleter() = default;
+
+        resource_deleter(
+            memory_resource* resource,
+            void* block,
+            std::size_t size,
+            std::size_t alignment) noexcept
+        : resource_(resource)
+        , block_(block)
+        , size_(size)
+        , alignment_(alignment) {}
+
+        template < typename T >
+        void operator()(T* p) const noexcept {
+            p->~T();
+            resource_->deallocate(block_, size_, alignment_);
+        }
+    private:
+        memory_resource* resource_{nullptr};
+        void* block_{nullptr};
+        std::size_t size_{0u};
+        std::size_t alignment_{0u};
+    };
+
+    template < typename T >
+    using resource_uptr = std::unique_ptr<T, resource_deleter>;
+
+    template < typename T, typename... Args >
+    resource_uptr<T> allocate_unique(memory_resource* resource, Args&&... args) {
+        void* block = resource->allocate(sizeof(T), alignof(T));
+        try {
+            return resource_uptr<T>(
+                ::new(block) T(std::forward<Args>(args)...),
+                resource_deleter(resource, block, sizeof(T), alignof(T)));
+        } catch (...) {
+            resource->deallocate(block, sizeof(T), alignof(T));
+            throw;
+        }
+    }
+}
+
+namespace ecs_hpp
+{
+    inline memory_resource* new_delete_resource() noexcept {
+        // never destroyed, so it outlives every static registry
+        static memory_resource* resource = new detail::new_delete_memory_resource();
+        return resource;
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -232,21 +681,37 @@ namespace ecs_hpp::detail
             std::is_void_v<Void>,
             "unexpected internal error");
     protected:
-        static family_id last_id_;
+        static std::atomic<family_id> last_id_;
     };
 
     template < typename T >
     class type_family final : public type_family_base<> {
     public:
         static family_id id() noexcept {
-            static family_id self_id = ++last_id_;
+            static const family_id self_id = static_cast<family_id>(
+                last_id_.fetch_add(1u, std::memory_order_relaxed) + 1u);
             assert(self_id > 0u && "ecs_hpp::family_id overflow");
             return self_id;
         }
     };
 
     template < typename Void >
-    family_id type_family_base<Void>::last_id_ = 0u;
+    std::atomic<family_id> type_family_base<Void>::last_id_{0u};
+
+    // the last registry slot of the type, registries check it before searching
+    template < typename T >
+    class type_slot final {
+    public:
+        static std::size_t hint() noexcept {
+            return hint_.load(std::memory_order_relaxed);
+        }
+
+        static void remember(std::size_t slot) noexcept {
+            hint_.store(slot, std::memory_order_relaxed);
+        }
+    private:
+        inline static std::atomic<std::size_t> hint_{0u};
+    };
 }
 
 // -----------------------------------------------------------------------------
@@ -265,6 +730,12 @@ namespace ecs_hpp::detail
             return static_cast<std::size_t>(v);
         }
     };
+
+    // a set of T can't hold more distinct values than T can represent,
+    // so the narrowest unsigned type of the same size fits every dense index
+    template < typename T >
+    using default_sparse_index_t = uint_least_t<
+        std::min(sizeof(T), sizeof(std::size_t)) * 8u>;
 }
 
 // -----------------------------------------------------------------------------
@@ -327,83 +798,322 @@ namespace ecs_hpp::detail
     private:
         incremental_locker& locker_;
     };
+
+    template < std::size_t N >
+    class incremental_lock_guards final {
+    public:
+        template < typename... Lockers >
+        incremental_lock_guards(Lockers&... lockers)
+        : lockers_{&lockers...} {
+            static_assert(sizeof...(Lockers) == N);
+            for ( incremental_locker* locker : lockers_ ) {
+                locker->lock();
+            }
+        }
+
+        ~incremental_lock_guards() noexcept {
+            for ( incremental_locker* locker : lockers_ ) {
+                locker->unlock();
+            }
+        }
+
+        incremental_lock_guards(const incremental_lock_guards&) = delete;
+        incremental_lock_guards& operator=(const incremental_lock_guards&) = delete;
+    private:
+        incremental_locker* lockers_[N];
+    };
 }
 
 // -----------------------------------------------------------------------------
 //
-// detail::sparse_set
+// detail::sparse_pages
 //
 // -----------------------------------------------------------------------------
 
 namespace ecs_hpp::detail
 {
     template < typename T
-             , typename Indexer = sparse_indexer<T> >
-    class sparse_set final {
+             , std::size_t PageSize = 1024u
+             , typename Allocator = std::allocator<T> >
+    class sparse_pages final {
+        static_assert(
+            PageSize > 0u && (PageSize & (PageSize - 1u)) == 0u,
+            "ecs_hpp (sparse page size must be a power of two)");
+        using alloc_traits = std::allocator_traits<Allocator>;
+        using page_vector = std::vector<T*, rebind_alloc_t<Allocator, T*>>;
     public:
-        using iterator = typename std::vector<T>::iterator;
-        using const_iterator = typename std::vector<T>::const_iterator;
+        static constexpr std::size_t page_size = PageSize;
+        using allocator_type = Allocator;
     public:
-        iterator begin() noexcept {
-            return dense_.begin();
+        explicit sparse_pages(const Allocator& allocator = Allocator())
+        : allocator_(allocator)
+        , pages_(allocator) {}
+
+        ~sparse_pages() noexcept {
+            release_();
         }
 
-        iterator end() noexcept {
-            return dense_.end();
+        sparse_pages(const sparse_pages& other)
+        : allocator_(alloc_traits::select_on_container_copy_construction(other.allocator_))
+        , pages_(other.pages_.size(), nullptr, allocator_) {
+            try {
+                for ( std::size_t i = 0; i < other.pages_.size(); ++i ) {
+                    if ( other.pages_[i] ) {
+                        pages_[i] = allocate_page_();
+                        ++page_count_;
+                        std::copy_n(other.pages_[i], page_size, pages_[i]);
+                    }
+                }
+            } catch (...) {
+                release_();
+                throw;
+            }
         }
 
-        const_iterator begin() const noexcept {
-            return dense_.begin();
+        sparse_pages& operator=(const sparse_pages& other) {
+            if ( this != &other ) {
+                sparse_pages p(other);
+                swap(p);
+            }
+            return *this;
         }
 
-        const_iterator end() const noexcept {
-            return dense_.end();
+        sparse_pages(sparse_pages&& other) noexcept
+        : allocator_(std::move(other.allocator_))
+        , pages_(std::move(other.pages_))
+        , page_count_(std::exchange(other.page_count_, 0u)) {}
+
+        sparse_pages& operator=(sparse_pages&& other) noexcept {
+            if ( this != &other ) {
+                sparse_pages p(std::move(other));
+                swap(p);
+            }
+            return *this;
         }
 
-        const_iterator cbegin() const noexcept {
-            return dense_.cbegin();
+        void swap(sparse_pages& other) noexcept {
+            using std::swap;
+            swap(allocator_, other.allocator_);
+            swap(pages_, other.pages_);
+            swap(page_count_, other.page_count_);
         }
 
-        const_iterator cend() const noexcept {
-            return dense_.cend();
+        T& assure(std::size_t i) {
+            const std::size_t pi = i / page_size;
+            if ( pi >= pages_.size() ) {
+                pages_.resize(next_capacity_size(
+                    pages_.size(), pi + 1u, pages_.max_size()), nullptr);
+            }
+            if ( !pages_[pi] ) {
+                pages_[pi] = allocate_page_();
+                ++page_count_;
+            }
+            return pages_[pi][i & (page_size - 1u)];
         }
-    public:
-        sparse_set(const Indexer& indexer = Indexer())
-        : indexer_(indexer) {}
 
-        sparse_set(const sparse_set& other) = default;
-        sparse_set& operator=(const sparse_set& other) = default;
+        T* find(std::size_t i) noexcept {
+            const std::size_t pi = i / page_size;
+            return pi < pages_.size() && pages_[pi]
+                ? &pages_[pi][i & (page_size - 1u)]
+                : nullptr;
+        }
 
-        sparse_set(sparse_set&& other) noexcept = default;
-        sparse_set& operator=(sparse_set&& other) noexcept = default;
+        const T* find(std::size_t i) const noexcept {
+            const std::size_t pi = i / page_size;
+            return pi < pages_.size() && pages_[pi]
+                ? &pages_[pi][i & (page_size - 1u)]
+                : nullptr;
+        }
 
-        void swap(sparse_set& other) noexcept {
-            using std::swap;
-            swap(dense_, other.dense_);
-            swap(sparse_, other.sparse_);
+        T& operator[](std::size_t i) noexcept {
+            assert(find(i));
+            return pages_[i / page_size][i & (page_size - 1u)];
         }
 
-        template < typename UT >
-        bool insert(UT&& v) {
-            if ( has(v) ) {
-                return false;
-            }
-            const std::size_t vi = indexer_(v);
-            if ( vi >= sparse_.size() ) {
-                sparse_.resize(next_capacity_size(
-                    sparse_.size(), vi + 1u, sparse_.max_size()));
-            }
-            dense_.push_back(std::forward<UT>(v));
-            sparse_[vi] = dense_.size() - 1u;
-            return true;
+        const T& operator[](std::size_t i) const noexcept {
+            assert(find(i));
+            return pages_[i / page_size][i & (page_size - 1u)];
         }
 
-        bool unordered_erase(const T& v) noexcept {
+        std::size_t page_count() const noexcept {
+            return page_count_;
+        }
+
+        // releases the pages of indices from `size` and above
+        void shrink_to_fit(std::size_t size) {
+            const std::size_t keep = (size + page_size - 1u) / page_size;
+            for ( std::size_t pi = keep; pi < pages_.size(); ++pi ) {
+                if ( pages_[pi] ) {
+                    std::destroy_n(pages_[pi], page_size);
+                    alloc_traits::deallocate(allocator_, pages_[pi], page_size);
+                    --page_count_;
+                }
+            }
+            if ( keep < pages_.size() ) {
+                pages_.resize(keep);
+                pages_.shrink_to_fit();
+            }
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_;
+        }
+
+        std::size_t memory_usage() const noexcept {
+            return pages_.capacity() * sizeof(pages_[0])
+                + page_count_ * page_size * sizeof(T);
+        }
+    private:
+        T* allocate_page_() {
+            T* page = alloc_traits::allocate(allocator_, page_size);
+            std::uninitialized_fill_n(page, page_size, T());
+            return page;
+        }
+
+        void release_() noexcept {
+            for ( T*& page : pages_ ) {
+                if ( page ) {
+                    std::destroy_n(page, page_size);
+                    alloc_traits::deallocate(allocator_, page, page_size);
+                    page = nullptr;
+                }
+            }
+            page_count_ = 0u;
+        }
+    private:
+        Allocator allocator_;
+        page_vector pages_;
+        std::size_t page_count_{0u};
+    };
+
+    template < typename T
+             , std::size_t PageSize
+             , typename Allocator >
+    void swap(
+        sparse_pages<T, PageSize, Allocator>& l,
+        sparse_pages<T, PageSize, Allocator>& r) noexcept
+    {
+        l.swap(r);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::sparse_set
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    template < typename T
+             , typename Indexer = sparse_indexer<T>
+             , typename Index = default_sparse_index_t<T>
+             , typename Allocator = std::allocator<T> >
+    class sparse_set final {
+        static_assert(std::is_unsigned_v<Index>);
+        static_assert(sizeof(Index) <= sizeof(std::size_t));
+        using dense_vector = std::vector<T, Allocator>;
+        using sparse_pages_type = sparse_pages<Index, 1024u, rebind_alloc_t<Allocator, Index>>;
+    public:
+        using allocator_type = Allocator;
+        using iterator = typename dense_vector::iterator;
+        using const_iterator = typename dense_vector::const_iterator;
+    public:
+        iterator begin() noexcept {
+            return dense_.begin();
+        }
+
+        iterator end() noexcept {
+            return dense_.end();
+        }
+
+        const_iterator begin() const noexcept {
+            return dense_.begin();
+        }
+
+        const_iterator end() const noexcept {
+            return dense_.end();
+        }
+
+        const_iterator cbegin() const noexcept {
+            return dense_.cbegin();
+        }
+
+        const_iterator cend() const noexcept {
+            return dense_.cend();
+        }
+    public:
+        sparse_set(
+            const Indexer& indexer = Indexer(),
+            const Allocator& allocator = Allocator())
+        : indexer_(indexer)
+        , dense_(allocator)
+        , sparse_(typename sparse_pages_type::allocator_type(allocator)) {}
+
+        sparse_set(const sparse_set& other) = default;
+        sparse_set& operator=(const sparse_set& other) = default;
+
+        sparse_set(sparse_set&& other) noexcept = default;
+        sparse_set& operator=(sparse_set&& other) noexcept = default;
+
+        void swap(sparse_set& other) noexcept {
+            using std::swap;
+            swap(dense_, other.dense_);
+            swap(sparse_, other.sparse_);
+        }
+
+        template < typename UT >
+        bool insert(UT&& v) {
+            if ( has(v) ) {
+                return false;
+            }
+            Index& dense_index = sparse_.assure(indexer_(v));
+            assert(dense_.size() <= std::numeric_limits<Index>::max());
+            dense_.push_back(std::forward<UT>(v));
+            dense_index = static_cast<Index>(dense_.size() - 1u);
+            return true;
+        }
+
+        // inserts all values or nothing, if any of them is present or repeated
+        template < typename ForwardIt >
+        bool insert_unique(ForwardIt first, ForwardIt last) {
+            for ( ForwardIt iter = first; iter != last; ++iter ) {
+                if ( has(*iter) ) {
+                    return false;
+                }
+            }
+            const std::size_t old_size = dense_.size();
+            const std::size_t new_size = old_size + static_cast<std::size_t>(std::distance(first, last));
+            assert(first == last || new_size - 1u <= std::numeric_limits<Index>::max());
+            if ( dense_.capacity() < new_size ) {
+                dense_.reserve(next_capacity_size(dense_.capacity(), new_size, dense_.max_size()));
+            }
+            std::size_t dense_index = old_size;
+            for ( ForwardIt iter = first; iter != last; ++iter ) {
+                sparse_.assure(indexer_(*iter)) = static_cast<Index>(dense_index++);
+            }
+            // a repeated value has the index of its last occurrence
+            dense_index = old_size;
+            for ( ForwardIt iter = first; iter != last; ++iter ) {
+                if ( sparse_[indexer_(*iter)] != dense_index++ ) {
+                    return false;
+                }
+            }
+            dense_.insert(dense_.end(), first, last);
+            return true;
+        }
+
+        void truncate(std::size_t size) noexcept {
+            assert(size <= dense_.size());
+            dense_.erase(dense_.begin() + static_cast<std::ptrdiff_t>(size), dense_.end());
+        }
+
+        bool unordered_erase(const T& v) noexcept {
             if ( !has(v) ) {
                 return false;
             }
             const std::size_t vi = indexer_(v);
-            const std::size_t dense_index = sparse_[vi];
+            const Index dense_index = sparse_[vi];
             if ( dense_index != dense_.size() - 1 ) {
                 using std::swap;
                 swap(dense_[dense_index], dense_.back());
@@ -413,15 +1123,25 @@ namespace ecs_hpp::detail
             return true;
         }
 
+        void swap_dense(std::size_t l, std::size_t r) noexcept {
+            assert(l < dense_.size() && r < dense_.size());
+            if ( l != r ) {
+                using std::swap;
+                swap(dense_[l], dense_[r]);
+                sparse_[indexer_(dense_[l])] = static_cast<Index>(l);
+                sparse_[indexer_(dense_[r])] = static_cast<Index>(r);
+            }
+        }
+
         void clear() noexcept {
             dense_.clear();
         }
 
         bool has(const T& v) const noexcept {
-            const std::size_t vi = indexer_(v);
-            return vi < sparse_.size()
-                && sparse_[vi] < dense_.size()
-                && dense_[sparse_[vi]] == v;
+            const Index* dense_index = sparse_.find(indexer_(v));
+            return dense_index
+                && *dense_index < dense_.size()
+                && dense_[*dense_index] == v;
         }
 
         const_iterator find(const T& v) const noexcept {
@@ -440,7 +1160,7 @@ namespace ecs_hpp::detail
 
         std::pair<std::size_t,bool> find_dense_index(const T& v) const noexcept {
             return has(v)
-                ? std::make_pair(sparse_[indexer_(v)], true)
+                ? std::make_pair(std::size_t(sparse_[indexer_(v)]), true)
                 : std::make_pair(std::size_t(-1), false);
         }
 
@@ -452,21 +1172,49 @@ namespace ecs_hpp::detail
             return dense_.size();
         }
 
+        std::size_t capacity() const noexcept {
+            return dense_.capacity();
+        }
+
+        std::size_t max_size() const noexcept {
+            return dense_.max_size();
+        }
+
+        void reserve(std::size_t capacity) {
+            dense_.reserve(capacity);
+        }
+
+        // the sparse pages past the highest value index are released
+        void shrink_to_fit() {
+            std::size_t sparse_size = 0u;
+            for ( const T& v : dense_ ) {
+                sparse_size = std::max(sparse_size, indexer_(v) + 1u);
+            }
+            sparse_.shrink_to_fit(sparse_size);
+            dense_.shrink_to_fit();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return dense_.get_allocator();
+        }
+
         std::size_t memory_usage() const noexcept {
             return dense_.capacity() * sizeof(dense_[0])
-                + sparse_.capacity() * sizeof(sparse_[0]);
+                + sparse_.memory_usage();
         }
     private:
         Indexer indexer_;
-        std::vector<T> dense_;
-        std::vector<std::size_t> sparse_;
+        dense_vector dense_;
+        sparse_pages_type sparse_;
     };
 
     template < typename T
-             , typename Indexer >
+             , typename Indexer
+             , typename Index
+             , typename Allocator >
     void swap(
-        sparse_set<T, Indexer>& l,
-        sparse_set<T, Indexer>& r) noexcept
+        sparse_set<T, Indexer, Index, Allocator>& l,
+        sparse_set<T, Indexer, Index, Allocator>& r) noexcept
     {
         l.swap(r);
     }
@@ -482,11 +1230,21 @@ namespace ecs_hpp::detail
 {
     template < typename K
              , typename T
-             , typename Indexer = sparse_indexer<K> >
+             , typename Indexer = sparse_indexer<K>
+             , typename Index = default_sparse_index_t<K>
+             , typename Allocator = std::allocator<T> >
     class sparse_map final {
+        using key_set = sparse_set<K, Indexer, Index, rebind_alloc_t<Allocator, K>>;
     public:
-        using iterator = typename std::vector<K>::iterator;
-        using const_iterator = typename std::vector<K>::const_iterator;
+        using allocator_type = Allocator;
+        using iterator = typename key_set::iterator;
+        using const_iterator = typename key_set::const_iterator;
+
+        using reference = T&;
+        using const_reference = const T&;
+
+        using pointer = T*;
+        using const_pointer = const T*;
     public:
         iterator begin() noexcept {
             return keys_.begin();
@@ -512,8 +1270,11 @@ namespace ecs_hpp::detail
             return keys_.cend();
         }
     public:
-        sparse_map(const Indexer& indexer = Indexer())
-        : keys_(indexer) {}
+        sparse_map(
+            const Indexer& indexer = Indexer(),
+            const Allocator& allocator = Allocator())
+        : keys_(indexer, typename key_set::allocator_type(allocator))
+        , values_(allocator) {}
 
         sparse_map(const sparse_map& other) = default;
         sparse_map& operator=(const sparse_map& other) = default;
@@ -558,6 +1319,50 @@ namespace ecs_hpp::detail
             }
         }
 
+        template < typename UK, typename... Args >
+        std::pair<T*, bool> emplace(UK&& k, Args&&... args) {
+            if ( T* value = find(k) ) {
+                return std::make_pair(value, false);
+            }
+            emplace_back_value(values_, std::forward<Args>(args)...);
+            try {
+                keys_.insert(std::forward<UK>(k));
+                return std::make_pair(&values_.back(), true);
+            } catch (...) {
+                values_.pop_back();
+                throw;
+            }
+        }
+
+        // appends the values in one pass or does nothing and returns false
+        // if any of the keys is present or repeated
+        template < typename KeyIt, typename ValueIt >
+        bool insert_unique(KeyIt first, KeyIt last, ValueIt values) {
+            const std::size_t old_size = values_.size();
+            if ( !keys_.insert_unique(first, last) ) {
+                return false;
+            }
+            try {
+                const std::size_t new_size = keys_.size();
+                if ( values_.capacity() < new_size ) {
+                    values_.reserve(next_capacity_size(values_.capacity(), new_size, values_.max_size()));
+                }
+                if constexpr ( std::is_same_v<ValueIt, repeat_iterator<T>> ) {
+                    // one value for the whole range, a plain fill for trivially copyable ones
+                    values_.insert(values_.end(), new_size - old_size, *values);
+                } else {
+                    for ( ; first != last; ++first, ++values ) {
+                        emplace_back_value(values_, *values);
+                    }
+                }
+            } catch (...) {
+                values_.erase(values_.begin() + static_cast<std::ptrdiff_t>(old_size), values_.end());
+                keys_.truncate(old_size);
+                throw;
+            }
+            return true;
+        }
+
         bool unordered_erase(const K& k) noexcept {
             const auto value_index_p = keys_.find_dense_index(k);
             if ( !value_index_p.second ) {
@@ -572,6 +1377,14 @@ namespace ecs_hpp::detail
             return true;
         }
 
+        void swap_dense(std::size_t l, std::size_t r) noexcept {
+            if ( l != r ) {
+                using std::swap;
+                keys_.swap_dense(l, r);
+                swap(values_[l], values_[r]);
+            }
+        }
+
         void clear() noexcept {
             keys_.clear();
             values_.clear();
@@ -581,6 +1394,25 @@ namespace ecs_hpp::detail
             return keys_.has(k);
         }
 
+        std::pair<std::size_t,bool> find_dense_index(const K& k) const noexcept {
+            return keys_.find_dense_index(k);
+        }
+
+        const K& key_at(std::size_t dense_index) const noexcept {
+            assert(dense_index < values_.size());
+            return keys_.cbegin()[static_cast<std::ptrdiff_t>(dense_index)];
+        }
+
+        T& value_at(std::size_t dense_index) noexcept {
+            assert(dense_index < values_.size());
+            return values_[dense_index];
+        }
+
+        const T& value_at(std::size_t dense_index) const noexcept {
+            assert(dense_index < values_.size());
+            return values_[dense_index];
+        }
+
         T& get(const K& k) {
             return values_[keys_.get_dense_index(k)];
         }
@@ -603,250 +1435,3231 @@ namespace ecs_hpp::detail
                 : nullptr;
         }
 
+        template < typename F >
+        void for_each(F&& f) {
+            auto value_iter = values_.begin();
+            for ( const K& k : keys_ ) {
+                f(k, *value_iter++);
+            }
+        }
+
+        template < typename F >
+        void for_each(F&& f) const {
+            auto value_iter = values_.cbegin();
+            for ( const K& k : keys_ ) {
+                f(k, *value_iter++);
+            }
+        }
+
         bool empty() const noexcept {
             return values_.empty();
         }
 
-        std::size_t size() const noexcept {
-            return values_.size();
+        std::size_t size() const noexcept {
+            return values_.size();
+        }
+
+        std::size_t capacity() const noexcept {
+            return values_.capacity();
+        }
+
+        std::size_t max_size() const noexcept {
+            return std::min(keys_.max_size(), values_.max_size());
+        }
+
+        void reserve(std::size_t capacity) {
+            keys_.reserve(capacity);
+            values_.reserve(capacity);
+        }
+
+        void shrink_to_fit() {
+            keys_.shrink_to_fit();
+            values_.shrink_to_fit();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return values_.get_allocator();
+        }
+
+        std::size_t memory_usage() const noexcept {
+            return keys_.memory_usage()
+                + values_.capacity() * sizeof(values_[0]);
+        }
+    private:
+        key_set keys_;
+        std::vector<T, Allocator> values_;
+    };
+
+    template < typename K
+             , typename T
+             , typename Indexer
+             , typename Index
+             , typename Allocator >
+    void swap(
+        sparse_map<K, T, Indexer, Index, Allocator>& l,
+        sparse_map<K, T, Indexer, Index, Allocator>& r) noexcept
+    {
+        l.swap(r);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::sparse_bitset
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    // one bit per index, every summary bit marks a non-empty word
+    // of the index bits, so empty ranges are skipped 4096 indices at once
+    template < typename Allocator = std::allocator<std::uint64_t> >
+    class sparse_bitset final {
+        using word_vector = std::vector<std::uint64_t, rebind_alloc_t<Allocator, std::uint64_t>>;
+    public:
+        using allocator_type = Allocator;
+    public:
+        sparse_bitset(const Allocator& allocator = Allocator())
+        : words_(allocator)
+        , summary_(allocator) {}
+
+        sparse_bitset(const sparse_bitset& other) = default;
+        sparse_bitset& operator=(const sparse_bitset& other) = default;
+
+        sparse_bitset(sparse_bitset&& other) noexcept
+        : words_(std::move(other.words_))
+        , summary_(std::move(other.summary_))
+        , size_(std::exchange(other.size_, 0u)) {}
+
+        sparse_bitset& operator=(sparse_bitset&& other) noexcept {
+            if ( this != &other ) {
+                words_ = std::move(other.words_);
+                summary_ = std::move(other.summary_);
+                size_ = std::exchange(other.size_, 0u);
+            }
+            return *this;
+        }
+
+        void swap(sparse_bitset& other) noexcept {
+            using std::swap;
+            swap(words_, other.words_);
+            swap(summary_, other.summary_);
+            swap(size_, other.size_);
+        }
+
+        bool insert(std::size_t i) {
+            const std::size_t wi = i / 64u;
+            if ( wi >= words_.size() ) {
+                const std::size_t word_count = next_capacity_size(
+                    words_.size(), wi + 1u, words_.max_size());
+                summary_.resize((word_count + 63u) / 64u, 0u);
+                words_.resize(word_count, 0u);
+            }
+            const std::uint64_t bit = std::uint64_t(1u) << (i % 64u);
+            if ( words_[wi] & bit ) {
+                return false;
+            }
+            words_[wi] |= bit;
+            summary_[wi / 64u] |= std::uint64_t(1u) << (wi % 64u);
+            ++size_;
+            return true;
+        }
+
+        bool erase(std::size_t i) noexcept {
+            if ( !has(i) ) {
+                return false;
+            }
+            const std::size_t wi = i / 64u;
+            words_[wi] &= ~(std::uint64_t(1u) << (i % 64u));
+            if ( !words_[wi] ) {
+                summary_[wi / 64u] &= ~(std::uint64_t(1u) << (wi % 64u));
+            }
+            --size_;
+            return true;
+        }
+
+        void clear() noexcept {
+            for ( std::size_t si = 0; si < summary_.size(); ++si ) {
+                for ( std::uint64_t bits = summary_[si]; bits; bits &= bits - 1u ) {
+                    words_[si * 64u + lowest_bit_index(bits)] = 0u;
+                }
+                summary_[si] = 0u;
+            }
+            size_ = 0u;
+        }
+
+        bool has(std::size_t i) const noexcept {
+            const std::size_t wi = i / 64u;
+            return wi < words_.size()
+                && (words_[wi] >> (i % 64u)) & 1u;
+        }
+
+        template < typename F >
+        void for_each(F&& f) const {
+            for ( std::size_t si = 0; si < summary_.size(); ++si ) {
+                for ( std::uint64_t sbits = summary_[si]; sbits; sbits &= sbits - 1u ) {
+                    const std::size_t wi = si * 64u + lowest_bit_index(sbits);
+                    for ( std::uint64_t bits = words_[wi]; bits; bits &= bits - 1u ) {
+                        f(wi * 64u + lowest_bit_index(bits));
+                    }
+                }
+            }
+        }
+
+        bool empty() const noexcept {
+            return !size_;
+        }
+
+        std::size_t size() const noexcept {
+            return size_;
+        }
+
+        std::size_t capacity() const noexcept {
+            return words_.size() * 64u;
+        }
+
+        // the words past the highest index are released
+        void shrink_to_fit() {
+            std::size_t word_count = 0u;
+            for ( std::size_t si = summary_.size(); si > 0u && !word_count; --si ) {
+                for ( std::uint64_t sbits = summary_[si - 1u]; sbits; sbits &= sbits - 1u ) {
+                    word_count = (si - 1u) * 64u + lowest_bit_index(sbits) + 1u;
+                }
+            }
+            if ( word_count < words_.size() ) {
+                words_.resize(word_count);
+                summary_.resize((word_count + 63u) / 64u);
+            }
+            words_.shrink_to_fit();
+            summary_.shrink_to_fit();
+        }
+
+        std::size_t memory_usage() const noexcept {
+            return words_.capacity() * sizeof(std::uint64_t)
+                + summary_.capacity() * sizeof(std::uint64_t);
+        }
+    private:
+        word_vector words_;
+        word_vector summary_;
+        std::size_t size_{0u};
+    };
+
+    template < typename Allocator >
+    void swap(
+        sparse_bitset<Allocator>& l,
+        sparse_bitset<Allocator>& r) noexcept
+    {
+        l.swap(r);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::signature_table
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    // a row of bits per entity index, a bit per component storage
+    template < typename Allocator = std::allocator<std::uint64_t> >
+    class signature_table final {
+        using word_vector = std::vector<std::uint64_t, rebind_alloc_t<Allocator, std::uint64_t>>;
+    public:
+        using allocator_type = Allocator;
+    public:
+        signature_table(const Allocator& allocator = Allocator())
+        : words_(allocator) {}
+
+        // returns true if the table is reallocated
+        bool assure(std::size_t row, std::size_t bit, const growth_policy& growth = growth_policy()) {
+            const std::size_t stride = std::max(stride_, bit / 64u + 1u);
+            const std::size_t rows = std::max(row_count_(), row + 1u);
+            if ( stride == stride_ && rows == row_count_() ) {
+                return false;
+            }
+            if ( stride == stride_ ) {
+                words_.resize(next_capacity_size(
+                    row_count_(), rows, words_.max_size() / stride, growth) * stride, 0u);
+                return true;
+            }
+            // more storages than bits in a row, every row is widened
+            word_vector words(words_.get_allocator());
+            words.resize(next_capacity_size(
+                row_count_(), rows, words.max_size() / stride, growth) * stride, 0u);
+            for ( std::size_t r = 0, e = row_count_(); r < e; ++r ) {
+                std::copy_n(
+                    words_.begin() + static_cast<std::ptrdiff_t>(r * stride_),
+                    stride_,
+                    words.begin() + static_cast<std::ptrdiff_t>(r * stride));
+            }
+            words_.swap(words);
+            stride_ = stride;
+            return true;
+        }
+
+        void set(std::size_t row, std::size_t bit) noexcept {
+            assert(row < row_count_() && bit / 64u < stride_);
+            words_[row * stride_ + bit / 64u] |= std::uint64_t(1u) << (bit % 64u);
+        }
+
+        void reset(std::size_t row, std::size_t bit) noexcept {
+            if ( row < row_count_() && bit / 64u < stride_ ) {
+                words_[row * stride_ + bit / 64u] &= ~(std::uint64_t(1u) << (bit % 64u));
+            }
+        }
+
+        void clear(std::size_t row) noexcept {
+            if ( row < row_count_() ) {
+                std::fill_n(
+                    words_.begin() + static_cast<std::ptrdiff_t>(row * stride_),
+                    stride_,
+                    std::uint64_t(0u));
+            }
+        }
+
+        bool test(std::size_t row, std::size_t bit) const noexcept {
+            return row < row_count_()
+                && bit / 64u < stride_
+                && (words_[row * stride_ + bit / 64u] >> (bit % 64u)) & 1u;
+        }
+
+        std::size_t count(std::size_t row) const noexcept {
+            std::size_t count = 0u;
+            for ( std::size_t w = 0; row < row_count_() && w < stride_; ++w ) {
+                count += bit_count(words_[row * stride_ + w]);
+            }
+            return count;
+        }
+
+        template < typename F >
+        void for_each(std::size_t row, F&& f) const {
+            for ( std::size_t w = 0; row < row_count_() && w < stride_; ++w ) {
+                for ( std::uint64_t bits = words_[row * stride_ + w]; bits; bits &= bits - 1u ) {
+                    f(w * 64u + lowest_bit_index(bits));
+                }
+            }
+        }
+
+        std::size_t capacity() const noexcept {
+            return words_.size();
+        }
+
+        // the empty rows past the last used one are released
+        void shrink_to_fit() {
+            std::size_t words = words_.size();
+            while ( words > 0u && !words_[words - 1u] ) {
+                --words;
+            }
+            words_.resize(stride_ ? (words + stride_ - 1u) / stride_ * stride_ : 0u);
+            words_.shrink_to_fit();
+        }
+
+        std::size_t memory_usage() const noexcept {
+            return words_.capacity() * sizeof(std::uint64_t);
+        }
+    private:
+        std::size_t row_count_() const noexcept {
+            return stride_ ? words_.size() / stride_ : 0u;
+        }
+    private:
+        word_vector words_;
+        std::size_t stride_{0u};
+    };
+}
+
+// -----------------------------------------------------------------------------
+//
+// soa_reference
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    //
+    // soa_field_count
+    //
+
+    constexpr std::size_t soa_max_field_count = 16u;
+
+    template < std::size_t I >
+    struct soa_any_field final {
+        template < typename T >
+        operator T() const noexcept;
+    };
+
+    template < typename T, typename Is, typename = void >
+    struct is_soa_constructible
+    : std::false_type {};
+
+    template < typename T, std::size_t... Is >
+    struct is_soa_constructible<
+        T,
+        std::index_sequence<Is...>,
+        std::void_t<decltype(T{soa_any_field<Is>{}...})>>
+    : std::true_type {};
+
+    template < typename T, std::size_t N = soa_max_field_count >
+    constexpr std::size_t soa_field_count() noexcept {
+        if constexpr ( N == 0u || is_soa_constructible<T, std::make_index_sequence<N>>::value ) {
+            return N;
+        } else {
+            return soa_field_count<T, N - 1u>();
+        }
+    }
+
+    //
+    // soa_tie
+    //
+
+    template < typename T >
+    auto soa_tie(T& v) noexcept {
+        using U = std::remove_const_t<T>;
+        static_assert(
+            std::is_aggregate_v<U>,
+            "ecs_hpp (soa component must be an aggregate)");
+        static_assert(
+            !is_soa_constructible<U, std::make_index_sequence<soa_max_field_count + 1u>>::value,
+            "ecs_hpp (soa component has too many fields)");
+        constexpr std::size_t n = soa_field_count<U>();
+        static_assert(n > 0u, "ecs_hpp (soa component must have fields)");
+        if constexpr ( n == 1u ) {
+            auto& [f1] = v;
+            return std::tie(f1);
+        } else if constexpr ( n == 2u ) {
+            auto& [f1, f2] = v;
+            return std::tie(f1, f2);
+        } else if constexpr ( n == 3u ) {
+            auto& [f1, f2, f3] = v;
+            return std::tie(f1, f2, f3);
+        } else if constexpr ( n == 4u ) {
+            auto& [f1, f2, f3, f4] = v;
+            return std::tie(f1, f2, f3, f4);
+        } else if constexpr ( n == 5u ) {
+            auto& [f1, f2, f3, f4, f5] = v;
+            return std::tie(f1, f2, f3, f4, f5);
+        } else if constexpr ( n == 6u ) {
+            auto& [f1, f2, f3, f4, f5, f6] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6);
+        } else if constexpr ( n == 7u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7);
+        } else if constexpr ( n == 8u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8);
+        } else if constexpr ( n == 9u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9);
+        } else if constexpr ( n == 10u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10);
+        } else if constexpr ( n == 11u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11);
+        } else if constexpr ( n == 12u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12);
+        } else if constexpr ( n == 13u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13);
+        } else if constexpr ( n == 14u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14);
+        } else if constexpr ( n == 15u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15);
+        } else if constexpr ( n == 16u ) {
+            auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16] = v;
+            return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16);
+        }
+    }
+
+    //
+    // soa_fields_t
+    //
+
+    template < typename Tuple >
+    struct soa_decay_fields;
+
+    template < typename... Fs >
+    struct soa_decay_fields<std::tuple<Fs&...>> {
+        using type = std::tuple<Fs...>;
+    };
+
+    template < typename T >
+    using soa_fields_t = typename soa_decay_fields<
+        decltype(soa_tie(std::declval<T&>()))>::type;
+
+    template < typename Fields, bool Const >
+    struct soa_field_pointers;
+
+    template < typename... Fs >
+    struct soa_field_pointers<std::tuple<Fs...>, false> {
+        using type = std::tuple<Fs*...>;
+    };
+
+    template < typename... Fs >
+    struct soa_field_pointers<std::tuple<Fs...>, true> {
+        using type = std::tuple<const Fs*...>;
+    };
+
+    template < typename Fields, typename Allocator >
+    struct soa_field_columns;
+
+    template < typename... Fs, typename Allocator >
+    struct soa_field_columns<std::tuple<Fs...>, Allocator> {
+        using type = std::tuple<std::vector<Fs, rebind_alloc_t<Allocator, Fs>>...>;
+
+        static type make(const Allocator& allocator) {
+            return type(std::vector<Fs, rebind_alloc_t<Allocator, Fs>>(
+                rebind_alloc_t<Allocator, Fs>(allocator))...);
+        }
+    };
+}
+
+namespace ecs_hpp
+{
+    template < typename T >
+    class soa_reference final {
+    public:
+        using value_type = std::remove_const_t<T>;
+        using fields_type = detail::soa_fields_t<value_type>;
+        using pointers_type = typename detail::soa_field_pointers<
+            fields_type,
+            std::is_const_v<T>>::type;
+        static constexpr std::size_t field_count = std::tuple_size_v<fields_type>;
+    public:
+        explicit soa_reference(const pointers_type& fields) noexcept
+        : fields_(fields) {}
+
+        soa_reference(const soa_reference& other) noexcept = default;
+
+        template < typename U = T
+                 , typename = std::enable_if_t<std::is_const_v<U>> >
+        soa_reference(const soa_reference<value_type>& other) noexcept
+        : fields_(other.fields_) {}
+
+        // assigns through to the columns, as a plain reference does
+        soa_reference& operator=(const soa_reference& other) {
+            return *this = other.load();
+        }
+
+        soa_reference& operator=(const value_type& v) {
+            store_(v, std::make_index_sequence<field_count>());
+            return *this;
+        }
+
+        soa_reference& operator=(value_type&& v) {
+            store_(std::move(v), std::make_index_sequence<field_count>());
+            return *this;
+        }
+
+        template < std::size_t I >
+        auto& get() const noexcept {
+            return *std::get<I>(fields_);
+        }
+
+        value_type load() const {
+            return load_(std::make_index_sequence<field_count>());
+        }
+
+        operator value_type() const {
+            return load();
+        }
+    private:
+        friend class soa_reference<const T>;
+        friend class soa_pointer<T>;
+
+        soa_reference() = default;
+
+        template < std::size_t... Is >
+        value_type load_(std::index_sequence<Is...>) const {
+            return value_type{*std::get<Is>(fields_)...};
+        }
+
+        template < typename V, std::size_t... Is >
+        void store_(V&& v, std::index_sequence<Is...>) {
+            static_assert(
+                !std::is_const_v<T>,
+                "ecs_hpp (can't assign through a const soa reference)");
+            auto fields = detail::soa_tie(v);
+            if constexpr ( std::is_lvalue_reference_v<V> ) {
+                (..., (void)(*std::get<Is>(fields_) = std::get<Is>(fields)));
+            } else {
+                (..., (void)(*std::get<Is>(fields_) = std::move(std::get<Is>(fields))));
+            }
+        }
+    private:
+        pointers_type fields_{};
+    };
+
+    template < typename T >
+    class soa_pointer final {
+    public:
+        soa_pointer() noexcept = default;
+        soa_pointer(std::nullptr_t) noexcept {}
+
+        explicit soa_pointer(const soa_reference<T>& ref) noexcept
+        : ref_(ref) {}
+
+        soa_pointer(const soa_pointer& other) noexcept = default;
+
+        template < typename U = T
+                 , typename = std::enable_if_t<std::is_const_v<U>> >
+        soa_pointer(const soa_pointer<std::remove_const_t<U>>& other) noexcept
+        : ref_(other.ref_) {}
+
+        // rebinds the pointer instead of assigning the components
+        soa_pointer& operator=(const soa_pointer& other) noexcept {
+            ref_.fields_ = other.ref_.fields_;
+            return *this;
+        }
+
+        soa_reference<T> operator*() const noexcept {
+            assert(*this);
+            return ref_;
+        }
+
+        const soa_reference<T>* operator->() const noexcept {
+            assert(*this);
+            return &ref_;
+        }
+
+        explicit operator bool() const noexcept {
+            return address_() != nullptr;
+        }
+
+        friend bool operator==(const soa_pointer& l, const soa_pointer& r) noexcept {
+            return l.address_() == r.address_();
+        }
+
+        friend bool operator!=(const soa_pointer& l, const soa_pointer& r) noexcept {
+            return !(l == r);
+        }
+    private:
+        friend class soa_pointer<const T>;
+
+        const void* address_() const noexcept {
+            return std::get<0>(ref_.fields_);
+        }
+    private:
+        soa_reference<T> ref_;
+    };
+}
+
+namespace std
+{
+    template < typename T >
+    struct tuple_size<ecs_hpp::soa_reference<T>>
+    : std::integral_constant<std::size_t, ecs_hpp::soa_reference<T>::field_count> {};
+
+    template < std::size_t I, typename T >
+    struct tuple_element<I, ecs_hpp::soa_reference<T>> {
+        using type = decltype(std::declval<const ecs_hpp::soa_reference<T>&>().template get<I>());
+    };
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::soa_map
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    template < typename K
+             , typename T
+             , typename Indexer = sparse_indexer<K>
+             , typename Index = default_sparse_index_t<K>
+             , typename Allocator = std::allocator<T> >
+    class soa_map final {
+        using fields_type = soa_fields_t<T>;
+        using columns_traits = soa_field_columns<fields_type, Allocator>;
+        using columns_type = typename columns_traits::type;
+        using field_indices = std::make_index_sequence<std::tuple_size_v<fields_type>>;
+        using key_set = sparse_set<K, Indexer, Index, rebind_alloc_t<Allocator, K>>;
+    public:
+        using allocator_type = Allocator;
+        using iterator = typename key_set::iterator;
+        using const_iterator = typename key_set::const_iterator;
+
+        using reference = soa_reference<T>;
+        using const_reference = soa_reference<const T>;
+
+        using pointer = soa_pointer<T>;
+        using const_pointer = soa_pointer<const T>;
+    public:
+        iterator begin() noexcept {
+            return keys_.begin();
+        }
+
+        iterator end() noexcept {
+            return keys_.end();
+        }
+
+        const_iterator begin() const noexcept {
+            return keys_.begin();
+        }
+
+        const_iterator end() const noexcept {
+            return keys_.end();
+        }
+
+        const_iterator cbegin() const noexcept {
+            return keys_.cbegin();
+        }
+
+        const_iterator cend() const noexcept {
+            return keys_.cend();
+        }
+    public:
+        soa_map(
+            const Indexer& indexer = Indexer(),
+            const Allocator& allocator = Allocator())
+        : keys_(indexer, typename key_set::allocator_type(allocator))
+        , columns_(columns_traits::make(allocator)) {}
+
+        soa_map(const soa_map& other) = default;
+        soa_map& operator=(const soa_map& other) = default;
+
+        soa_map(soa_map&& other) noexcept = default;
+        soa_map& operator=(soa_map&& other) noexcept = default;
+
+        void swap(soa_map& other) noexcept {
+            using std::swap;
+            swap(keys_, other.keys_);
+            swap(columns_, other.columns_);
+        }
+
+        template < typename UK, typename UT >
+        std::pair<pointer, bool> insert(UK&& k, UT&& v) {
+            if ( pointer value = find(k) ) {
+                return std::make_pair(value, false);
+            }
+            push_back_(std::forward<UT>(v), field_indices());
+            try {
+                keys_.insert(std::forward<UK>(k));
+                return std::make_pair(pointer(value_at(size() - 1u)), true);
+            } catch (...) {
+                pop_back_(field_indices());
+                throw;
+            }
+        }
+
+        template < typename UK, typename UT >
+        std::pair<pointer, bool> insert_or_assign(UK&& k, UT&& v) {
+            if ( pointer value = find(k) ) {
+                *value = std::forward<UT>(v);
+                return std::make_pair(value, false);
+            }
+            return insert(std::forward<UK>(k), std::forward<UT>(v));
+        }
+
+        // the fields are stored apart, so the value is built once and split
+        template < typename UK, typename... Args >
+        std::pair<pointer, bool> emplace(UK&& k, Args&&... args) {
+            if ( pointer value = find(k) ) {
+                return std::make_pair(value, false);
+            }
+            return insert(std::forward<UK>(k), make_value<T>(std::forward<Args>(args)...));
+        }
+
+        bool unordered_erase(const K& k) noexcept {
+            const auto value_index_p = keys_.find_dense_index(k);
+            if ( !value_index_p.second ) {
+                return false;
+            }
+            swap_columns_(value_index_p.first, size() - 1u, field_indices());
+            pop_back_(field_indices());
+            keys_.unordered_erase(k);
+            return true;
+        }
+
+        void swap_dense(std::size_t l, std::size_t r) noexcept {
+            if ( l != r ) {
+                keys_.swap_dense(l, r);
+                swap_columns_(l, r, field_indices());
+            }
+        }
+
+        void clear() noexcept {
+            keys_.clear();
+            std::apply([](auto&... columns){
+                (..., columns.clear());
+            }, columns_);
+        }
+
+        bool has(const K& k) const noexcept {
+            return keys_.has(k);
+        }
+
+        std::pair<std::size_t,bool> find_dense_index(const K& k) const noexcept {
+            return keys_.find_dense_index(k);
+        }
+
+        const K& key_at(std::size_t dense_index) const noexcept {
+            assert(dense_index < size());
+            return keys_.cbegin()[static_cast<std::ptrdiff_t>(dense_index)];
+        }
+
+        reference value_at(std::size_t dense_index) noexcept {
+            assert(dense_index < size());
+            return std::apply([dense_index](auto&... columns){
+                return reference(std::make_tuple(&columns[dense_index]...));
+            }, columns_);
+        }
+
+        const_reference value_at(std::size_t dense_index) const noexcept {
+            assert(dense_index < size());
+            return std::apply([dense_index](const auto&... columns){
+                return const_reference(std::make_tuple(&columns[dense_index]...));
+            }, columns_);
+        }
+
+        reference get(const K& k) {
+            return value_at(keys_.get_dense_index(k));
+        }
+
+        const_reference get(const K& k) const {
+            return value_at(keys_.get_dense_index(k));
+        }
+
+        pointer find(const K& k) noexcept {
+            const auto value_index_p = keys_.find_dense_index(k);
+            return value_index_p.second
+                ? pointer(value_at(value_index_p.first))
+                : pointer();
+        }
+
+        const_pointer find(const K& k) const noexcept {
+            const auto value_index_p = keys_.find_dense_index(k);
+            return value_index_p.second
+                ? const_pointer(value_at(value_index_p.first))
+                : const_pointer();
+        }
+
+        template < typename F >
+        void for_each(F&& f) {
+            std::size_t dense_index = 0u;
+            for ( const K& k : keys_ ) {
+                f(k, value_at(dense_index++));
+            }
+        }
+
+        template < typename F >
+        void for_each(F&& f) const {
+            std::size_t dense_index = 0u;
+            for ( const K& k : keys_ ) {
+                f(k, value_at(dense_index++));
+            }
+        }
+
+        template < std::size_t I >
+        auto* column() noexcept {
+            return std::get<I>(columns_).data();
+        }
+
+        template < std::size_t I >
+        const auto* column() const noexcept {
+            return std::get<I>(columns_).data();
+        }
+
+        bool empty() const noexcept {
+            return keys_.empty();
+        }
+
+        std::size_t size() const noexcept {
+            return keys_.size();
+        }
+
+        std::size_t capacity() const noexcept {
+            return keys_.capacity();
+        }
+
+        std::size_t max_size() const noexcept {
+            return std::apply([this](const auto&... columns){
+                return std::min({keys_.max_size(), columns.max_size()...});
+            }, columns_);
+        }
+
+        void reserve(std::size_t capacity) {
+            keys_.reserve(capacity);
+            std::apply([capacity](auto&... columns){
+                (..., columns.reserve(capacity));
+            }, columns_);
+        }
+
+        void shrink_to_fit() {
+            keys_.shrink_to_fit();
+            std::apply([](auto&... columns){
+                (..., columns.shrink_to_fit());
+            }, columns_);
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type(keys_.get_allocator());
+        }
+
+        std::size_t memory_usage() const noexcept {
+            return std::apply([this](const auto&... columns){
+                return (keys_.memory_usage() + ... +
+                    (columns.capacity() * sizeof(typename std::decay_t<decltype(columns)>::value_type)));
+            }, columns_);
+        }
+    private:
+        template < typename UT, std::size_t... Is >
+        void push_back_(UT&& v, std::index_sequence<Is...>) {
+            auto fields = soa_tie(v);
+            std::size_t pushed = 0u;
+            try {
+                if constexpr ( std::is_lvalue_reference_v<UT> ) {
+                    (..., (void(std::get<Is>(columns_).push_back(std::get<Is>(fields))), ++pushed));
+                } else {
+                    (..., (void(std::get<Is>(columns_).push_back(std::move(std::get<Is>(fields)))), ++pushed));
+                }
+            } catch (...) {
+                (..., (Is < pushed ? std::get<Is>(columns_).pop_back() : void()));
+                throw;
+            }
+        }
+
+        template < std::size_t... Is >
+        void pop_back_(std::index_sequence<Is...>) noexcept {
+            (..., std::get<Is>(columns_).pop_back());
+        }
+
+        template < std::size_t... Is >
+        void swap_columns_(std::size_t l, std::size_t r, std::index_sequence<Is...>) noexcept {
+            if ( l != r ) {
+                using std::swap;
+                (..., swap(std::get<Is>(columns_)[l], std::get<Is>(columns_)[r]));
+            }
+        }
+    private:
+        key_set keys_;
+        columns_type columns_;
+    };
+
+    template < typename K
+             , typename T
+             , typename Indexer
+             , typename Index
+             , typename Allocator >
+    void swap(
+        soa_map<K, T, Indexer, Index, Allocator>& l,
+        soa_map<K, T, Indexer, Index, Allocator>& r) noexcept
+    {
+        l.swap(r);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::stable_map
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    template < typename K
+             , typename T
+             , typename Indexer = sparse_indexer<K>
+             , typename Index = default_sparse_index_t<K>
+             , std::size_t PageSize = 1024u
+             , typename Allocator = std::allocator<T> >
+    class stable_map final {
+        static_assert(
+            PageSize > 0u && (PageSize & (PageSize - 1u)) == 0u,
+            "ecs_hpp (stable page size must be a power of two)");
+        using slot_map = sparse_map<K, std::size_t, Indexer, Index,
+            rebind_alloc_t<Allocator, std::size_t>>;
+    public:
+        using allocator_type = Allocator;
+
+        using reference = T&;
+        using const_reference = const T&;
+
+        using pointer = T*;
+        using const_pointer = const T*;
+
+        static constexpr std::size_t page_size = PageSize;
+    public:
+        stable_map(
+            const Indexer& indexer = Indexer(),
+            const Allocator& allocator = Allocator())
+        : slots_(indexer, typename slot_map::allocator_type(allocator))
+        , pages_(page_pointer_allocator(allocator))
+        , free_slots_(typename slot_map::allocator_type(allocator))
+        , page_allocator_(allocator) {}
+
+        ~stable_map() noexcept {
+            clear();
+        }
+
+        stable_map(const stable_map& other)
+        : stable_map(Indexer(), std::allocator_traits<Allocator>::
+            select_on_container_copy_construction(other.get_allocator())) {
+            other.for_each([this](const K& k, const T& v){
+                insert(k, v);
+            });
+        }
+
+        stable_map& operator=(const stable_map& other) {
+            if ( this != &other ) {
+                stable_map m(other);
+                swap(m);
+            }
+            return *this;
+        }
+
+        stable_map(stable_map&& other) noexcept
+        : slots_(std::move(other.slots_))
+        , pages_(std::move(other.pages_))
+        , free_slots_(std::move(other.free_slots_))
+        , slot_count_(std::exchange(other.slot_count_, 0u))
+        , page_allocator_(std::move(other.page_allocator_)) {}
+
+        stable_map& operator=(stable_map&& other) noexcept {
+            if ( this != &other ) {
+                stable_map m(std::move(other));
+                swap(m);
+            }
+            return *this;
+        }
+
+        void swap(stable_map& other) noexcept {
+            using std::swap;
+            swap(slots_, other.slots_);
+            swap(pages_, other.pages_);
+            swap(free_slots_, other.free_slots_);
+            swap(slot_count_, other.slot_count_);
+            swap(page_allocator_, other.page_allocator_);
+        }
+
+        template < typename UK, typename UT >
+        std::pair<T*, bool> insert(UK&& k, UT&& v) {
+            return emplace(std::forward<UK>(k), std::forward<UT>(v));
+        }
+
+        template < typename UK, typename... Args >
+        std::pair<T*, bool> emplace(UK&& k, Args&&... args) {
+            if ( T* value = find(k) ) {
+                return std::make_pair(value, false);
+            }
+            const std::size_t slot = acquire_slot_();
+            page& p = *pages_[slot / page_size];
+            const std::size_t i = slot % page_size;
+            try {
+                T* value = construct_value<T>(p.values[i].data, std::forward<Args>(args)...);
+                try {
+                    slots_.insert(k, slot);
+                } catch (...) {
+                    value->~T();
+                    throw;
+                }
+                p.keys[i] = std::forward<UK>(k);
+                p.used[i / 64u] |= std::uint64_t(1u) << (i % 64u);
+                ++p.live;
+                return std::make_pair(value, true);
+            } catch (...) {
+                release_slot_(slot);
+                throw;
+            }
+        }
+
+        template < typename UK, typename UT >
+        std::pair<T*, bool> insert_or_assign(UK&& k, UT&& v) {
+            if ( T* value = find(k) ) {
+                *value = std::forward<UT>(v);
+                return std::make_pair(value, false);
+            }
+            return insert(std::forward<UK>(k), std::forward<UT>(v));
+        }
+
+        bool unordered_erase(const K& k) noexcept {
+            const std::size_t* slot_p = slots_.find(k);
+            if ( !slot_p ) {
+                return false;
+            }
+            const std::size_t slot = *slot_p;
+            slots_.unordered_erase(k);
+
+            page& p = *pages_[slot / page_size];
+            const std::size_t i = slot % page_size;
+            value_at_(slot)->~T();
+            p.used[i / 64u] &= ~(std::uint64_t(1u) << (i % 64u));
+            --p.live;
+            release_slot_(slot);
+
+            // the empty pages are released once more than a half of the slots are free
+            if ( !p.live && free_slots_.size() * 2u > slot_count_ ) {
+                for ( page*& ep : pages_ ) {
+                    if ( ep && !ep->live ) {
+                        destroy_page_(ep);
+                    }
+                }
+            }
+            return true;
+        }
+
+        void clear() noexcept {
+            for ( page*& p : pages_ ) {
+                if ( p ) {
+                    for_each_used_(*p, [p](std::size_t i){
+                        std::launder(reinterpret_cast<T*>(p->values[i].data))->~T();
+                    });
+                    destroy_page_(p);
+                }
+            }
+            slots_.clear();
+            free_slots_.clear();
+            slot_count_ = 0u;
+        }
+
+        bool has(const K& k) const noexcept {
+            return slots_.has(k);
+        }
+
+        std::pair<std::size_t,bool> find_dense_index(const K& k) const noexcept {
+            const std::size_t* slot_p = slots_.find(k);
+            return slot_p
+                ? std::make_pair(*slot_p, true)
+                : std::make_pair(std::size_t(0u), false);
+        }
+
+        const K& key_at(std::size_t slot) const noexcept {
+            assert(slot < slot_count_ && pages_[slot / page_size]);
+            return pages_[slot / page_size]->keys[slot % page_size];
+        }
+
+        T& value_at(std::size_t slot) noexcept {
+            assert(slot < slot_count_ && pages_[slot / page_size]);
+            return *value_at_(slot);
+        }
+
+        const T& value_at(std::size_t slot) const noexcept {
+            assert(slot < slot_count_ && pages_[slot / page_size]);
+            return *value_at_(slot);
+        }
+
+        T& get(const K& k) {
+            return *value_at_(slots_.get(k));
+        }
+
+        const T& get(const K& k) const {
+            return *value_at_(slots_.get(k));
+        }
+
+        T* find(const K& k) noexcept {
+            const std::size_t* slot_p = slots_.find(k);
+            return slot_p
+                ? value_at_(*slot_p)
+                : nullptr;
+        }
+
+        const T* find(const K& k) const noexcept {
+            const std::size_t* slot_p = slots_.find(k);
+            return slot_p
+                ? value_at_(*slot_p)
+                : nullptr;
+        }
+
+        template < typename F >
+        void for_each(F&& f) {
+            for ( page* p : pages_ ) {
+                if ( p && p->live ) {
+                    for_each_used_(*p, [&f, p](std::size_t i){
+                        f(std::as_const(p->keys[i]),
+                            *std::launder(reinterpret_cast<T*>(p->values[i].data)));
+                    });
+                }
+            }
+        }
+
+        template < typename F >
+        void for_each(F&& f) const {
+            for ( page* p : pages_ ) {
+                if ( p && p->live ) {
+                    for_each_used_(*p, [&f, p](std::size_t i){
+                        f(std::as_const(p->keys[i]),
+                            *std::launder(reinterpret_cast<const T*>(p->values[i].data)));
+                    });
+                }
+            }
+        }
+
+        bool empty() const noexcept {
+            return slots_.empty();
+        }
+
+        std::size_t size() const noexcept {
+            return slots_.size();
+        }
+
+        std::size_t capacity() const noexcept {
+            return slot_count_;
+        }
+
+        // values never move, so only the empty pages and the free slots
+        // past the last used one are released
+        void shrink_to_fit() {
+            std::size_t slot_count = 0u;
+            for ( std::size_t pi = pages_.size(); pi > 0u && !slot_count; --pi ) {
+                if ( const page* p = pages_[pi - 1u]; p && p->live ) {
+                    for_each_used_(*p, [&slot_count, pi](std::size_t i){
+                        slot_count = (pi - 1u) * page_size + i + 1u;
+                    });
+                }
+            }
+            if ( slot_count < slot_count_ ) {
+                // the free slots keep a capacity for every slot
+                std::vector<std::size_t, rebind_alloc_t<Allocator, std::size_t>> free_slots(
+                    free_slots_.get_allocator());
+                free_slots.reserve(slot_count);
+                std::copy_if(
+                    free_slots_.begin(), free_slots_.end(),
+                    std::back_inserter(free_slots),
+                    [slot_count](std::size_t slot){ return slot < slot_count; });
+                std::make_heap(free_slots.begin(), free_slots.end(), std::greater<>());
+                free_slots_.swap(free_slots);
+                slot_count_ = slot_count;
+            }
+            for ( page*& p : pages_ ) {
+                if ( p && !p->live ) {
+                    destroy_page_(p);
+                }
+            }
+            pages_.resize((slot_count_ + page_size - 1u) / page_size);
+            pages_.shrink_to_fit();
+            slots_.shrink_to_fit();
+        }
+
+        std::size_t page_count() const noexcept {
+            return static_cast<std::size_t>(std::count_if(
+                pages_.begin(), pages_.end(),
+                [](const page* p){ return !!p; }));
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type(page_allocator_);
+        }
+
+        std::size_t memory_usage() const noexcept {
+            return slots_.memory_usage()
+                + pages_.capacity() * sizeof(pages_[0])
+                + page_count() * sizeof(page)
+                + free_slots_.capacity() * sizeof(free_slots_[0]);
+        }
+    private:
+        struct page final {
+            struct slot final {
+                alignas(T) unsigned char data[sizeof(T)];
+            };
+            slot values[page_size];
+            K keys[page_size]{};
+            std::uint64_t used[(page_size + 63u) / 64u]{};
+            std::size_t live{0u};
+        };
+
+        using page_allocator = rebind_alloc_t<Allocator, page>;
+        using page_pointer_allocator = rebind_alloc_t<Allocator, page*>;
+        using page_alloc_traits = std::allocator_traits<page_allocator>;
+
+        template < typename F >
+        static void for_each_used_(const page& p, F&& f) {
+            for ( std::size_t w = 0; w < std::size(p.used); ++w ) {
+                // empty words of the occupancy mask are skipped at once
+                for ( std::uint64_t bits = p.used[w]; bits; bits &= bits - 1u ) {
+                    f(w * 64u + lowest_bit_index(bits));
+                }
+            }
+        }
+
+        T* value_at_(std::size_t slot) noexcept {
+            page& p = *pages_[slot / page_size];
+            return std::launder(reinterpret_cast<T*>(p.values[slot % page_size].data));
+        }
+
+        const T* value_at_(std::size_t slot) const noexcept {
+            const page& p = *pages_[slot / page_size];
+            return std::launder(reinterpret_cast<const T*>(p.values[slot % page_size].data));
+        }
+
+        std::size_t acquire_slot_() {
+            // the lowest free slots are reused first, so the last pages can drain
+            std::size_t slot = slot_count_;
+            if ( !free_slots_.empty() ) {
+                std::pop_heap(free_slots_.begin(), free_slots_.end(), std::greater<>());
+                slot = free_slots_.back();
+                free_slots_.pop_back();
+            } else {
+                if ( free_slots_.capacity() <= slot_count_ ) {
+                    // ensure free slots capacity for safe (noexcept) erasing
+                    free_slots_.reserve(next_capacity_size(
+                        free_slots_.capacity(),
+                        slot_count_ + 1u,
+                        free_slots_.max_size()));
+                }
+                if ( pages_.size() <= slot / page_size ) {
+                    pages_.resize(slot / page_size + 1u, nullptr);
+                }
+                ++slot_count_;
+            }
+            try {
+                if ( !pages_[slot / page_size] ) {
+                    pages_[slot / page_size] = create_page_();
+                }
+            } catch (...) {
+                release_slot_(slot);
+                throw;
+            }
+            return slot;
+        }
+
+        page* create_page_() {
+            page* p = page_alloc_traits::allocate(page_allocator_, 1u);
+            ::new(static_cast<void*>(p)) page();
+            return p;
+        }
+
+        void destroy_page_(page*& p) noexcept {
+            p->~page();
+            page_alloc_traits::deallocate(page_allocator_, p, 1u);
+            p = nullptr;
+        }
+
+        void release_slot_(std::size_t slot) noexcept {
+            assert(free_slots_.size() < free_slots_.capacity());
+            free_slots_.push_back(slot);
+            std::push_heap(free_slots_.begin(), free_slots_.end(), std::greater<>());
+        }
+    private:
+        slot_map slots_;
+        std::vector<page*, page_pointer_allocator> pages_;
+        std::vector<std::size_t, rebind_alloc_t<Allocator, std::size_t>> free_slots_;
+        std::size_t slot_count_{0u};
+        page_allocator page_allocator_;
+    };
+
+    template < typename K
+             , typename T
+             , typename Indexer
+             , typename Index
+             , std::size_t PageSize
+             , typename Allocator >
+    void swap(
+        stable_map<K, T, Indexer, Index, PageSize, Allocator>& l,
+        stable_map<K, T, Indexer, Index, PageSize, Allocator>& r) noexcept
+    {
+        l.swap(r);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::shared_handle
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    // the counter isn't atomic, like the rest of a registry
+    template < typename T >
+    class shared_handle final {
+        struct node {
+            template < typename... Args >
+            node(memory_resource* r, Args&&... args)
+            : resource(r)
+            , value(make_value<T>(std::forward<Args>(args)...)) {}
+
+            std::size_t refs{1u};
+            memory_resource* resource{nullptr};
+            T value;
+        };
+    public:
+        static constexpr std::size_t node_size = sizeof(node);
+    public:
+        shared_handle() = default;
+
+        ~shared_handle() noexcept {
+            release_();
+        }
+
+        shared_handle(const shared_handle& other) noexcept
+        : node_(other.node_) {
+            if ( node_ ) {
+                ++node_->refs;
+            }
+        }
+
+        shared_handle& operator=(const shared_handle& other) noexcept {
+            if ( this != &other ) {
+                shared_handle h(other);
+                swap(h);
+            }
+            return *this;
+        }
+
+        shared_handle(shared_handle&& other) noexcept
+        : node_(std::exchange(other.node_, nullptr)) {}
+
+        shared_handle& operator=(shared_handle&& other) noexcept {
+            if ( this != &other ) {
+                shared_handle h(std::move(other));
+                swap(h);
+            }
+            return *this;
+        }
+
+        void swap(shared_handle& other) noexcept {
+            std::swap(node_, other.node_);
+        }
+
+        template < typename... Args >
+        static shared_handle make(memory_resource* resource, Args&&... args) {
+            void* block = resource->allocate(sizeof(node), alignof(node));
+            try {
+                shared_handle h;
+                h.node_ = ::new(block) node(resource, std::forward<Args>(args)...);
+                return h;
+            } catch (...) {
+                resource->deallocate(block, sizeof(node), alignof(node));
+                throw;
+            }
+        }
+
+        const T& value() const noexcept {
+            assert(node_);
+            return node_->value;
+        }
+
+        T& unique_value() noexcept {
+            assert(node_ && node_->refs == 1u);
+            return node_->value;
+        }
+
+        std::size_t use_count() const noexcept {
+            return node_ ? node_->refs : 0u;
+        }
+
+        explicit operator bool() const noexcept {
+            return !!node_;
+        }
+    private:
+        void release_() noexcept {
+            if ( node_ && !--node_->refs ) {
+                memory_resource* resource = node_->resource;
+                node_->~node();
+                resource->deallocate(node_, sizeof(node), alignof(node));
+            }
+            node_ = nullptr;
+        }
+    private:
+        node* node_{nullptr};
+    };
+
+    template < typename T >
+    void swap(shared_handle<T>& l, shared_handle<T>& r) noexcept {
+        l.swap(r);
+    }
+
+    template < typename T, typename... Args >
+    struct is_shared_handle_args : std::false_type {};
+
+    template < typename T, typename A >
+    struct is_shared_handle_args<T, A>
+    : std::is_same<std::decay_t<A>, shared_handle<T>> {};
+
+    template < typename T, typename... Args >
+    inline constexpr bool is_shared_handle_args_v = is_shared_handle_args<T, Args...>::value;
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::entity_id_indexer
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    struct entity_id_indexer final {
+        std::size_t operator()(entity_id id) const noexcept {
+            return entity_id_index(id);
+        }
+    };
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::component_storage
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    inline entity_id find_alive_entity_id(const registry& owner, std::size_t index) noexcept;
+
+    class component_storage_base;
+    using component_storage_uptr = resource_uptr<component_storage_base>;
+
+    class component_group_base;
+    using component_group_uptr = resource_uptr<component_group_base>;
+
+    class component_group_base {
+    public:
+        component_group_base(std::size_t type_count) noexcept
+        : type_count_(type_count) {}
+
+        virtual ~component_group_base() = default;
+        virtual void on_insert(entity_id id) noexcept = 0;
+        virtual void on_remove(entity_id id) noexcept = 0;
+        virtual void on_remove_all() noexcept = 0;
+
+        // `storages` are indexed by signature bits
+        virtual component_group_uptr fork(
+            const component_storage_uptr* storages,
+            memory_resource* resource) const = 0;
+
+        std::size_t size() const noexcept {
+            return size_;
+        }
+
+        std::size_t type_count() const noexcept {
+            return type_count_;
+        }
+    protected:
+        std::size_t size_{0u};
+        std::size_t type_count_{0u};
+    };
+
+    class component_storage_base {
+    public:
+        virtual ~component_storage_base() = default;
+        virtual bool remove(entity_id id) noexcept = 0;
+        virtual std::size_t remove_each(const entity_id* first, const entity_id* last) noexcept = 0;
+        virtual bool has(entity_id id) const noexcept = 0;
+        virtual void clone(entity_id from, entity_id to) = 0;
+        virtual void clone_each(entity_id from, const entity_id* first, const entity_id* last) = 0;
+        virtual std::size_t count() const noexcept = 0;
+        virtual std::size_t capacity() const noexcept = 0;
+        virtual void shrink_to_fit() = 0;
+        virtual std::size_t memory_usage() const noexcept = 0;
+        virtual detail::incremental_locker& locker() const noexcept = 0;
+        virtual component_storage_uptr fork(registry& owner, memory_resource* resource) const = 0;
+
+        // joins pin their storages, so `compact` keeps them until the join ends
+        detail::incremental_locker& join_locker() const noexcept {
+            return join_locker_;
+        }
+
+        // the size is compared with the largest size since the last shrinking
+        // too, so a fragmented storage isn't shrunk again on every removal
+        void shrink_if_sparse(double min_occupancy, std::size_t min_capacity) noexcept {
+            const std::size_t size = count();
+            peak_count_ = std::max(peak_count_, size + 1u);
+            const std::size_t reference = std::min(capacity(), peak_count_);
+            if ( capacity() >= min_capacity
+                && static_cast<double>(size) < min_occupancy * static_cast<double>(reference) )
+            {
+                try {
+                    shrink_to_fit();
+                } catch (...) {
+                    // shrinking is optional, the storage keeps its capacity
+                }
+                peak_count_ = size;
+            }
+        }
+
+        component_group_base* group() const noexcept {
+            return group_;
+        }
+
+        void set_group(component_group_base* group) noexcept {
+            group_ = group;
+        }
+
+        family_id family() const noexcept {
+            return family_;
+        }
+
+        void set_family(family_id family) noexcept {
+            family_ = family;
+        }
+
+        std::size_t signature_bit() const noexcept {
+            return signature_bit_;
+        }
+
+        void set_signature_bit(std::size_t bit) noexcept {
+            signature_bit_ = bit;
+        }
+
+        // a custom policy isn't replaced by the registry ones
+        void set_growth_policy(const growth_policy& policy, bool custom) noexcept {
+            if ( custom || !custom_growth_ ) {
+                growth_ = policy;
+                custom_growth_ = custom_growth_ || custom;
+            }
+        }
+
+        bool custom_growth() const noexcept {
+            return custom_growth_;
+        }
+
+        void set_growth_observer(growth_observer* observer) noexcept {
+            growth_observer_ = observer;
+        }
+    protected:
+        component_storage_base() = default;
+
+        // a forked storage isn't grouped until its registry forks the group
+        component_storage_base(const component_storage_base& other) noexcept
+        : family_(other.family_)
+        , signature_bit_(other.signature_bit_)
+        , peak_count_(other.peak_count_)
+        , growth_(other.growth_)
+        , custom_growth_(other.custom_growth_)
+        , growth_observer_(other.growth_observer_) {}
+
+        component_storage_base& operator=(const component_storage_base&) = delete;
+
+        template < typename Map >
+        void reserve_next_(Map& map) noexcept {
+            if ( growth_.mode == growth_mode::native ) {
+                return;
+            }
+            try {
+                map.reserve(next_capacity_size(
+                    map.capacity(), map.size() + 1u, map.max_size(), growth_));
+            } catch (...) {
+                // the container grows by itself on the next insertion
+            }
+        }
+
+        void notify_growth_(
+            std::size_t element_size,
+            std::size_t old_capacity,
+            std::size_t new_capacity) const noexcept
+        {
+            if ( growth_observer_ && old_capacity != new_capacity ) {
+                growth_observer_->on_growth(growth_event{
+                    family_, element_size, old_capacity, new_capacity});
+            }
+        }
+    protected:
+        component_group_base* group_{nullptr};
+        family_id family_{0u};
+        std::size_t signature_bit_{0u};
+        std::size_t peak_count_{0u};
+        growth_policy growth_;
+        bool custom_growth_{false};
+        growth_observer* growth_observer_{nullptr};
+        mutable detail::incremental_locker join_locker_;
+    };
+
+    struct empty_storage_policy {};
+
+    template < typename T, typename = void >
+    struct component_storage_policy {
+        using type = std::conditional_t<
+            std::is_empty_v<T>,
+            empty_storage_policy,
+            dense_storage_policy>;
+    };
+
+    template < typename T >
+    struct component_storage_policy<
+        T,
+        std::void_t<typename component_traits<T>::storage_policy>>
+    {
+        using type = std::conditional_t<
+            std::is_empty_v<T>,
+            empty_storage_policy,
+            typename component_traits<T>::storage_policy>;
+    };
+
+    template < typename T >
+    using component_storage_policy_t = typename component_storage_policy<T>::type;
+
+    template < typename T >
+    inline constexpr bool is_shared_component_v =
+        std::is_same_v<component_storage_policy_t<T>, shared_storage_policy>;
+
+    template < typename T, typename Policy >
+    struct component_map;
+
+    template < typename T >
+    struct component_map<T, dense_storage_policy> {
+        using type = sparse_map<
+            entity_id,
+            T,
+            entity_id_indexer,
+            entity_id_sparse_index,
+            resource_allocator<T>>;
+    };
+
+    template < typename T >
+    struct component_map<T, soa_storage_policy> {
+        using type = soa_map<
+            entity_id,
+            T,
+            entity_id_indexer,
+            entity_id_sparse_index,
+            resource_allocator<T>>;
+    };
+
+    template < typename T >
+    struct component_map<T, stable_storage_policy> {
+        using type = stable_map<
+            entity_id,
+            T,
+            entity_id_indexer,
+            entity_id_sparse_index,
+            1024u,
+            resource_allocator<T>>;
+    };
+
+    template < typename T, typename Policy = component_storage_policy_t<T> >
+    class component_storage final : public component_storage_base {
+        using map_type = typename component_map<T, Policy>::type;
+    public:
+        using reference = typename map_type::reference;
+        using const_reference = typename map_type::const_reference;
+
+        using pointer = typename map_type::pointer;
+        using const_pointer = typename map_type::const_pointer;
+    public:
+        component_storage(registry& owner, memory_resource* resource)
+        : owner_(owner)
+        , components_(entity_id_indexer(), resource_allocator<T>(resource)) {}
+
+        // the dense arrays are copied as is, so a forked group keeps its order
+        component_storage(const component_storage& other, registry& owner)
+        : component_storage_base(other)
+        , owner_(owner)
+        , components_(other.components_) {}
+
+        template < typename... Args >
+        reference assign(entity_id id, Args&&... args) {
+            if ( pointer value = components_.find(id) ) {
+                assign_value<T>(*value, std::forward<Args>(args)...);
+                return *value;
+            }
+            assert(!components_locker_.is_locked());
+            return emplace_(id, std::forward<Args>(args)...);
+        }
+
+        template < typename... Args >
+        reference ensure(entity_id id, Args&&... args) {
+            if ( pointer value = components_.find(id) ) {
+                return *value;
+            }
+            assert(!components_locker_.is_locked());
+            return emplace_(id, std::forward<Args>(args)...);
+        }
+
+        // the dense arrays take the whole range at once when none of the ids
+        // has the component yet, otherwise the values are assigned one by one
+        template < typename IdIt, typename ValueIt >
+        void assign_range(IdIt first, IdIt last, ValueIt values) {
+            assert(!components_locker_.is_locked());
+            if constexpr ( std::is_same_v<Policy, dense_storage_policy> ) {
+                const std::size_t old_capacity = components_.capacity();
+                if ( components_.insert_unique(first, last, values) ) {
+                    if ( group_ ) {
+                        for ( ; first != last; ++first ) {
+                            group_->on_insert(*first);
+                        }
+                    }
+                    if ( components_.size() == components_.capacity() ) {
+                        reserve_next_(components_);
+                    }
+                    notify_growth_(sizeof(T), old_capacity, components_.capacity());
+                    return;
+                }
+            }
+            for ( ; first != last; ++first, ++values ) {
+                assign(*first, *values);
+            }
+        }
+
+        bool exists(entity_id id) const noexcept {
+            return components_.has(id);
+        }
+
+        bool remove(entity_id id) noexcept override {
+            assert(!components_locker_.is_locked());
+            if ( group_ ) {
+                group_->on_remove(id);
+            }
+            return components_.unordered_erase(id);
+        }
+
+        std::size_t remove_each(const entity_id* first, const entity_id* last) noexcept override {
+            assert(!components_locker_.is_locked());
+            std::size_t removed_count = 0u;
+            for ( ; first != last; ++first ) {
+                if ( group_ ) {
+                    group_->on_remove(*first);
+                }
+                if ( components_.unordered_erase(*first) ) {
+                    ++removed_count;
+                }
+            }
+            return removed_count;
+        }
+
+        std::size_t remove_all() noexcept {
+            assert(!components_locker_.is_locked());
+            if ( group_ ) {
+                group_->on_remove_all();
+            }
+            const std::size_t count = components_.size();
+            components_.clear();
+            return count;
+        }
+
+        pointer find(entity_id id) noexcept {
+            return components_.find(id);
+        }
+
+        const_pointer find(entity_id id) const noexcept {
+            return components_.find(id);
+        }
+
+        std::size_t count() const noexcept override {
+            return components_.size();
+        }
+
+        std::size_t capacity() const noexcept override {
+            return components_.capacity();
+        }
+
+        void shrink_to_fit() override {
+            assert(!components_locker_.is_locked());
+            components_.shrink_to_fit();
+        }
+
+        bool has(entity_id id) const noexcept override {
+            return components_.has(id);
+        }
+
+        void clone(entity_id from, entity_id to) override {
+            if ( const_pointer c = find(from) ) {
+                assign(to, T(*c));
+            }
+        }
+
+        void clone_each(entity_id from, const entity_id* first, const entity_id* last) override {
+            if ( const_pointer c = find(from) ) {
+                // the source is copied out, the storage may grow
+                const T value(*c);
+                assign_range(first, last, repeat_iterator<T>(value));
+            }
+        }
+
+        template < typename F >
+        void for_each_component(F&& f) {
+            detail::incremental_lock_guard lock(components_locker_);
+            components_.for_each(f);
+        }
+
+        template < typename F >
+        void for_each_component(F&& f) const {
+            detail::incremental_lock_guard lock(components_locker_);
+            components_.for_each(f);
+        }
+
+        std::size_t memory_usage() const noexcept override {
+            return components_.memory_usage();
+        }
+
+        std::pair<std::size_t,bool> find_dense_index(entity_id id) const noexcept {
+            return components_.find_dense_index(id);
+        }
+
+        void swap_dense(std::size_t l, std::size_t r) noexcept {
+            components_.swap_dense(l, r);
+        }
+
+        // `less` compares dense indices, the components are moved by cycles
+        template < typename Less >
+        void sort(Less&& less) {
+            static_assert(
+                !std::is_same_v<Policy, stable_storage_policy>,
+                "ecs_hpp (stable component storages can't be sorted)");
+            assert(!components_locker_.is_locked());
+            using index_allocator = rebind_alloc_t<
+                typename map_type::allocator_type,
+                std::size_t>;
+            std::vector<std::size_t, index_allocator> order(
+                components_.size(),
+                index_allocator(components_.get_allocator()));
+            std::iota(order.begin(), order.end(), std::size_t(0u));
+            std::sort(order.begin(), order.end(), std::forward<Less>(less));
+            for ( std::size_t i = 0; i < order.size(); ++i ) {
+                std::size_t dense_index = i;
+                while ( order[dense_index] != i ) {
+                    const std::size_t next_index = order[dense_index];
+                    components_.swap_dense(dense_index, next_index);
+                    order[dense_index] = dense_index;
+                    dense_index = next_index;
+                }
+                order[dense_index] = dense_index;
+            }
+        }
+
+        entity_id id_at(std::size_t dense_index) const noexcept {
+            return components_.key_at(dense_index);
+        }
+
+        reference component_at(std::size_t dense_index) noexcept {
+            return components_.value_at(dense_index);
+        }
+
+        const_reference component_at(std::size_t dense_index) const noexcept {
+            return components_.value_at(dense_index);
+        }
+
+        detail::incremental_locker& locker() const noexcept override {
+            return components_locker_;
+        }
+
+        component_storage_uptr fork(registry& owner, memory_resource* resource) const override {
+            return allocate_unique<component_storage>(resource, *this, owner);
+        }
+    private:
+        template < typename... Args >
+        reference emplace_(entity_id id, Args&&... args) {
+            if constexpr ( std::is_same_v<Policy, stable_storage_policy> ) {
+                // stable components grow by pages, nothing is reallocated
+                return *insert_(id, std::forward<Args>(args)...);
+            } else {
+                // the arguments may refer to the stored components, so the capacity
+                // is reserved after an insertion for the next one, or in advance
+                // while there is nothing to refer to
+                const std::size_t old_capacity = components_.capacity();
+                if ( !old_capacity ) {
+                    reserve_next_(components_);
+                }
+                pointer inserted = insert_(id, std::forward<Args>(args)...);
+                if ( const std::size_t capacity = components_.capacity(); components_.size() == capacity ) {
+                    reserve_next_(components_);
+                    if ( components_.capacity() != capacity ) {
+                        inserted = components_.find(id);
+                    }
+                }
+                notify_growth_(sizeof(T), old_capacity, components_.capacity());
+                return *inserted;
+            }
+        }
+
+        template < typename... Args >
+        pointer insert_(entity_id id, Args&&... args) {
+            pointer inserted = components_.emplace(id, std::forward<Args>(args)...).first;
+            if ( group_ ) {
+                // the group may move the new component to its front
+                group_->on_insert(id);
+                inserted = components_.find(id);
+            }
+            return inserted;
+        }
+    private:
+        registry& owner_;
+        mutable detail::incremental_locker components_locker_;
+        map_type components_;
+    };
+
+    template < typename T >
+    class component_storage<T, shared_storage_policy> final : public component_storage_base {
+        using handle_type = shared_handle<T>;
+        using map_type = sparse_map<
+            entity_id,
+            handle_type,
+            entity_id_indexer,
+            entity_id_sparse_index,
+            resource_allocator<handle_type>>;
+    public:
+        using reference = const T&;
+        using const_reference = const T&;
+
+        using pointer = const T*;
+        using const_pointer = const T*;
+    public:
+        component_storage(registry&, memory_resource* resource)
+        : resource_(resource)
+        , components_(entity_id_indexer(), resource_allocator<handle_type>(resource)) {}
+
+        // the values are shared with the forked storage until they're assigned
+        component_storage(const component_storage& other, registry&)
+        : component_storage_base(other)
+        , resource_(other.resource_)
+        , components_(other.components_) {}
+
+        // a handle argument is shared, a value owned by the entity alone is assigned
+        // in place and a jointly owned one is replaced by a new instance
+        template < typename... Args >
+        const T& assign(entity_id id, Args&&... args) {
+            if constexpr ( is_shared_handle_args_v<T, Args...> ) {
+                return share_(id, std::forward<Args>(args)...);
+            } else {
+                handle_type* handle = components_.find(id);
+                if ( handle && handle->use_count() == 1u ) {
+                    assign_value<T>(handle->unique_value(), std::forward<Args>(args)...);
+                    return handle->value();
+                }
+                return share_(id, handle_type::make(resource_, std::forward<Args>(args)...));
+            }
+        }
+
+        template < typename IdIt, typename ValueIt >
+        void assign_range(IdIt first, IdIt last, ValueIt values) {
+            for ( ; first != last; ++first, ++values ) {
+                assign(*first, *values);
+            }
+        }
+
+        template < typename... Args >
+        const T& ensure(entity_id id, Args&&... args) {
+            if ( const handle_type* handle = components_.find(id) ) {
+                return handle->value();
+            }
+            if constexpr ( is_shared_handle_args_v<T, Args...> ) {
+                return share_(id, std::forward<Args>(args)...);
+            } else {
+                return share_(id, handle_type::make(resource_, std::forward<Args>(args)...));
+            }
+        }
+
+        // copy on write, the entity gets its own instance
+        T* detach(entity_id id) {
+            handle_type* handle = components_.find(id);
+            if ( !handle ) {
+                return nullptr;
+            }
+            if ( handle->use_count() > 1u ) {
+                *handle = handle_type::make(resource_, handle->value());
+            }
+            return &handle->unique_value();
+        }
+
+        std::size_t use_count(entity_id id) const noexcept {
+            const handle_type* handle = components_.find(id);
+            return handle ? handle->use_count() : 0u;
+        }
+
+        std::pair<std::size_t,bool> find_dense_index(entity_id id) const noexcept {
+            return components_.find_dense_index(id);
+        }
+
+        void swap_dense(std::size_t l, std::size_t r) noexcept {
+            components_.swap_dense(l, r);
+        }
+
+        entity_id id_at(std::size_t dense_index) const noexcept {
+            return components_.key_at(dense_index);
+        }
+
+        const T& component_at(std::size_t dense_index) const noexcept {
+            return components_.value_at(dense_index).value();
+        }
+
+        bool exists(entity_id id) const noexcept {
+            return components_.has(id);
+        }
+
+        bool remove(entity_id id) noexcept override {
+            assert(!components_locker_.is_locked());
+            return components_.unordered_erase(id);
+        }
+
+        std::size_t remove_each(const entity_id* first, const entity_id* last) noexcept override {
+            assert(!components_locker_.is_locked());
+            std::size_t removed_count = 0u;
+            for ( ; first != last; ++first ) {
+                if ( components_.unordered_erase(*first) ) {
+                    ++removed_count;
+                }
+            }
+            return removed_count;
+        }
+
+        std::size_t remove_all() noexcept {
+            assert(!components_locker_.is_locked());
+            const std::size_t count = components_.size();
+            components_.clear();
+            return count;
+        }
+
+        const T* find(entity_id id) const noexcept {
+            const handle_type* handle = components_.find(id);
+            return handle ? &handle->value() : nullptr;
+        }
+
+        std::size_t count() const noexcept override {
+            return components_.size();
+        }
+
+        std::size_t capacity() const noexcept override {
+            return components_.capacity();
+        }
+
+        void shrink_to_fit() override {
+            assert(!components_locker_.is_locked());
+            components_.shrink_to_fit();
+        }
+
+        bool has(entity_id id) const noexcept override {
+            return components_.has(id);
+        }
+
+        void clone(entity_id from, entity_id to) override {
+            if ( const handle_type* handle = components_.find(from) ) {
+                share_(to, *handle);
+            }
+        }
+
+        void clone_each(entity_id from, const entity_id* first, const entity_id* last) override {
+            if ( const handle_type* handle = components_.find(from) ) {
+                const handle_type value(*handle);
+                assign_range(first, last, repeat_iterator<handle_type>(value));
+            }
+        }
+
+        template < typename F >
+        void for_each_component(F&& f) const {
+            detail::incremental_lock_guard lock(components_locker_);
+            components_.for_each([&f](entity_id id, const handle_type& handle){
+                f(id, handle.value());
+            });
+        }
+
+        // jointly owned instances aren't counted
+        std::size_t memory_usage() const noexcept override {
+            std::size_t usage = components_.memory_usage();
+            components_.for_each([&usage](entity_id, const handle_type& handle){
+                if ( handle.use_count() == 1u ) {
+                    usage += handle_type::node_size;
+                }
+            });
+            return usage;
+        }
+
+        detail::incremental_locker& locker() const noexcept override {
+            return components_locker_;
+        }
+
+        component_storage_uptr fork(registry& owner, memory_resource* resource) const override {
+            return allocate_unique<component_storage>(resource, *this, owner);
+        }
+    private:
+        const T& share_(entity_id id, handle_type handle) {
+            if ( handle_type* value = components_.find(id) ) {
+                *value = std::move(handle);
+                return value->value();
+            }
+            assert(!components_locker_.is_locked());
+            const std::size_t old_capacity = components_.capacity();
+            const handle_type* inserted = components_.insert(id, std::move(handle)).first;
+            const T& value = inserted->value();
+            if ( components_.size() == components_.capacity() ) {
+                reserve_next_(components_);
+            }
+            notify_growth_(sizeof(handle_type), old_capacity, components_.capacity());
+            return value;
+        }
+    private:
+        memory_resource* resource_{nullptr};
+        mutable detail::incremental_locker components_locker_;
+        map_type components_;
+    };
+
+    template < typename T >
+    class component_storage<T, empty_storage_policy> final : public component_storage_base {
+    public:
+        using reference = T&;
+        using const_reference = const T&;
+
+        using pointer = T*;
+        using const_pointer = const T*;
+    public:
+        component_storage(registry& owner, memory_resource* resource)
+        : owner_(owner)
+        , components_(resource_allocator<std::uint64_t>(resource)) {}
+
+        component_storage(const component_storage& other, registry& owner)
+        : component_storage_base(other)
+        , owner_(owner)
+        , components_(other.components_) {}
+
+        template < typename... Args >
+        T& assign(entity_id id, Args&&...) {
+            if ( components_.has(entity_id_index(id)) ) {
+                return empty_value_;
+            }
+            assert(!components_locker_.is_locked());
+            components_.insert(entity_id_index(id));
+            return empty_value_;
+        }
+
+        template < typename IdIt, typename ValueIt >
+        void assign_range(IdIt first, IdIt last, ValueIt) {
+            assert(!components_locker_.is_locked());
+            for ( ; first != last; ++first ) {
+                components_.insert(entity_id_index(*first));
+            }
+        }
+
+        template < typename... Args >
+        T& ensure(entity_id id, Args&&...) {
+            if ( components_.has(entity_id_index(id)) ) {
+                return empty_value_;
+            }
+            assert(!components_locker_.is_locked());
+            components_.insert(entity_id_index(id));
+            return empty_value_;
+        }
+
+        bool exists(entity_id id) const noexcept {
+            return components_.has(entity_id_index(id));
+        }
+
+        bool remove(entity_id id) noexcept override {
+            assert(!components_locker_.is_locked());
+            return components_.erase(entity_id_index(id));
+        }
+
+        std::size_t remove_each(const entity_id* first, const entity_id* last) noexcept override {
+            assert(!components_locker_.is_locked());
+            std::size_t removed_count = 0u;
+            for ( ; first != last; ++first ) {
+                if ( components_.erase(entity_id_index(*first)) ) {
+                    ++removed_count;
+                }
+            }
+            return removed_count;
+        }
+
+        std::size_t remove_all() noexcept {
+            assert(!components_locker_.is_locked());
+            const std::size_t count = components_.size();
+            components_.clear();
+            return count;
+        }
+
+        T* find(entity_id id) noexcept {
+            return components_.has(entity_id_index(id))
+                ? &empty_value_
+                : nullptr;
+        }
+
+        const T* find(entity_id id) const noexcept {
+            return components_.has(entity_id_index(id))
+                ? &empty_value_
+                : nullptr;
+        }
+
+        std::size_t count() const noexcept override {
+            return components_.size();
+        }
+
+        std::size_t capacity() const noexcept override {
+            return components_.capacity();
+        }
+
+        void shrink_to_fit() override {
+            assert(!components_locker_.is_locked());
+            components_.shrink_to_fit();
+        }
+
+        bool has(entity_id id) const noexcept override {
+            return components_.has(entity_id_index(id));
+        }
+
+        void clone(entity_id from, entity_id to) override {
+            if ( const T* c = find(from) ) {
+                assign(to, *c);
+            }
+        }
+
+        void clone_each(entity_id from, const entity_id* first, const entity_id* last) override {
+            if ( exists(from) ) {
+                assign_range(first, last, repeat_iterator<T>(empty_value_));
+            }
+        }
+
+        template < typename F >
+        void for_each_component(F&& f) {
+            detail::incremental_lock_guard lock(components_locker_);
+            components_.for_each([this, &f](std::size_t index){
+                f(find_alive_entity_id(owner_, index), empty_value_);
+            });
+        }
+
+        template < typename F >
+        void for_each_component(F&& f) const {
+            detail::incremental_lock_guard lock(components_locker_);
+            components_.for_each([this, &f](std::size_t index){
+                f(find_alive_entity_id(owner_, index), empty_value_);
+            });
+        }
+
+        std::size_t memory_usage() const noexcept override {
+            return components_.memory_usage();
+        }
+
+        detail::incremental_locker& locker() const noexcept override {
+            return components_locker_;
+        }
+
+        component_storage_uptr fork(registry& owner, memory_resource* resource) const override {
+            return allocate_unique<component_storage>(resource, *this, owner);
+        }
+    private:
+        registry& owner_;
+        static T empty_value_;
+        mutable detail::incremental_locker components_locker_;
+        // components are removed with their entities,
+        // so the entity index is enough to identify the owner
+        detail::sparse_bitset<resource_allocator<std::uint64_t>> components_;
+    };
+
+    template < typename T >
+    T component_storage<T, empty_storage_policy>::empty_value_;
+}
+
+namespace ecs_hpp
+{
+    template < typename T >
+    using component_reference = typename detail::component_storage<T>::reference;
+    template < typename T >
+    using const_component_reference = typename detail::component_storage<T>::const_reference;
+
+    template < typename T >
+    using component_pointer = typename detail::component_storage<T>::pointer;
+    template < typename T >
+    using const_component_pointer = typename detail::component_storage<T>::const_pointer;
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::component_group
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    template < typename... Ts >
+    class component_group final : public component_group_base {
+        static_assert(
+            sizeof...(Ts) > 1u,
+            "ecs_hpp (component group must own at least two components)");
+        static_assert(
+            (... && !std::is_empty_v<Ts>),
+            "ecs_hpp (empty components can't be owned by component group)");
+        static_assert(
+            (... && !std::is_same_v<component_storage_policy_t<Ts>, stable_storage_policy>),
+            "ecs_hpp (stable components can't be owned by component group)");
+        static_assert(
+            (... && !is_shared_component_v<Ts>),
+            "ecs_hpp (shared components can't be owned by component group)");
+    public:
+        component_group(component_storage<Ts>&... storages)
+        : component_group_base(sizeof...(Ts))
+        , storages_(&storages...)
+        {
+            assert(!is_locked_());
+            component_storage_base* const bases[] = {&storages...};
+            for ( component_storage_base* base : bases ) {
+                base->set_group(this);
+            }
+            auto& driver = *std::get<0>(storages_);
+            for ( std::size_t i = 0, e = driver.count(); i < e; ++i ) {
+                if ( has_all_(driver.id_at(i)) ) {
+                    move_to_front_(driver.id_at(i));
+                }
+            }
+        }
+
+        // the storages are forked from grouped ones, so they're ordered already
+        component_group(std::size_t size, component_storage<Ts>*... storages) noexcept
+        : component_group_base(sizeof...(Ts))
+        , storages_(storages...)
+        {
+            size_ = size;
+            component_storage_base* const bases[] = {storages...};
+            for ( component_storage_base* base : bases ) {
+                base->set_group(this);
+            }
+        }
+
+        ~component_group() noexcept override {
+            std::apply([](auto*... ss){
+                (..., ss->set_group(nullptr));
+            }, storages_);
+        }
+
+        component_group(const component_group&) = delete;
+        component_group& operator=(const component_group&) = delete;
+
+        void on_insert(entity_id id) noexcept override {
+            assert(!is_locked_());
+            if ( has_all_(id) ) {
+                move_to_front_(id);
+            }
+        }
+
+        void on_remove(entity_id id) noexcept override {
+            assert(!is_locked_());
+            const auto p = std::get<0>(storages_)->find_dense_index(id);
+            if ( p.second && p.first < size_ ) {
+                --size_;
+                std::apply([this, id](auto*... ss){
+                    (..., ss->swap_dense(ss->find_dense_index(id).first, size_));
+                }, storages_);
+            }
+        }
+
+        void on_remove_all() noexcept override {
+            assert(!is_locked_());
+            size_ = 0u;
+        }
+
+        component_group_uptr fork(
+            const component_storage_uptr* storages,
+            memory_resource* resource) const override
+        {
+            return std::apply([this, storages, resource](auto*... ss){
+                return allocate_unique<component_group>(
+                    resource,
+                    size_,
+                    static_cast<decltype(ss)>(storages[ss->signature_bit()].get())...);
+            }, storages_);
+        }
+    private:
+        bool is_locked_() const noexcept {
+            return std::apply([](const auto*... ss){
+                return (... || ss->locker().is_locked());
+            }, storages_);
+        }
+
+        bool has_all_(entity_id id) const noexcept {
+            return std::apply([id](const auto*... ss){
+                return (... && ss->exists(id));
+            }, storages_);
+        }
+
+        void move_to_front_(entity_id id) noexcept {
+            std::apply([this, id](auto*... ss){
+                (..., ss->swap_dense(ss->find_dense_index(id).first, size_));
+            }, storages_);
+            ++size_;
+        }
+    private:
+        std::tuple<component_storage<Ts>*...> storages_;
+    };
+
+    template < typename T >
+    T* component_address(T& component) noexcept {
+        return std::addressof(component);
+    }
+
+    template < typename T >
+    soa_pointer<T> component_address(soa_reference<T>& component) noexcept {
+        return soa_pointer<T>(component);
+    }
+
+    template < typename T >
+    soa_pointer<T> component_address(const soa_reference<T>& component) noexcept {
+        return soa_pointer<T>(component);
+    }
+
+    template < typename T >
+    soa_pointer<T> component_address(soa_reference<T>&& component) noexcept {
+        return soa_pointer<T>(component);
+    }
+
+    template < bool Driver, typename S, typename P >
+    auto find_joined_component(S* storage, entity_id id, const P& driver) noexcept {
+        if constexpr ( Driver ) {
+            (void)storage;
+            (void)id;
+            return driver;
+        } else {
+            (void)driver;
+            return storage->find(id);
+        }
+    }
+
+    template < std::size_t I, typename... Ss, typename P, std::size_t... Is >
+    auto find_joined_components(
+        const std::tuple<Ss*...>& ss,
+        entity_id id,
+        const P& driver,
+        std::index_sequence<Is...>) noexcept
+    {
+        return std::make_tuple(
+            find_joined_component<Is == I>(std::get<Is>(ss), id, driver)...);
+    }
+
+    template < typename T >
+    component_pointer<T> find_grouped_component(
+        component_storage<T>& storage,
+        const component_group_base* group,
+        std::size_t dense_index,
+        entity_id id) noexcept
+    {
+        if constexpr ( std::is_empty_v<T> ) {
+            (void)group;
+            (void)dense_index;
+            return storage.find(id);
+        } else {
+            return storage.group() == group
+                ? component_address(storage.component_at(dense_index))
+                : storage.find(id);
+        }
+    }
+
+    template < typename T >
+    const_component_pointer<T> find_grouped_component(
+        const component_storage<T>& storage,
+        const component_group_base* group,
+        std::size_t dense_index,
+        entity_id id) noexcept
+    {
+        if constexpr ( std::is_empty_v<T> ) {
+            (void)group;
+            (void)dense_index;
+            return storage.find(id);
+        } else {
+            return storage.group() == group
+                ? component_address(storage.component_at(dense_index))
+                : storage.find(id);
+        }
+    }
+
+    struct joined_driver final {
+        std::size_t index{0u};
+        bool grouped{false};
+    };
+
+    template < typename... Ss >
+    joined_driver select_joined_driver(const std::tuple<Ss*...>& ss) noexcept {
+        return std::apply([](const auto*... storages){
+            const std::size_t counts[] = {storages->count()...};
+            const component_group_base* groups[] = {storages->group()...};
+
+            // the smallest storage drives the join, the others are probed
+            joined_driver driver;
+            for ( std::size_t i = 1; i < sizeof...(storages); ++i ) {
+                if ( counts[i] < counts[driver.index] ) {
+                    driver.index = i;
+                }
+            }
+
+            // a group owned entirely by the join is walked without probing
+            for ( std::size_t i = 0; i < sizeof...(storages); ++i ) {
+                const component_group_base* g = groups[i];
+                if ( !g || g->size() > counts[driver.index] ) {
+                    continue;
+                }
+                const auto owned = std::count(std::begin(groups), std::end(groups), g);
+                if ( static_cast<std::size_t>(owned) == g->type_count() ) {
+                    return joined_driver{i, true};
+                }
+            }
+
+            return driver;
+        }, ss);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//
+// detail::archetype
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp::detail
+{
+    template < typename T
+             , typename U = std::remove_const_t<T>
+             , typename R = std::conditional_t<
+                std::is_const_v<T>,
+                const_component_reference<U>,
+                component_reference<U>> >
+    R to_component_reference(T& value) noexcept {
+        if constexpr ( std::is_reference_v<R> ) {
+            return value;
+        } else {
+            return R(std::apply([](auto&... fields){
+                return std::make_tuple(&fields...);
+            }, soa_tie(value)));
+        }
+    }
+
+    template < typename T >
+    using archetype_vector = std::vector<T, resource_allocator<T>>;
+
+    using archetype_edges = sparse_map<
+        family_id,
+        std::size_t,
+        sparse_indexer<family_id>,
+        default_sparse_index_t<family_id>,
+        resource_allocator<std::size_t>>;
+
+    class archetype_column_base;
+    using archetype_column_uptr = resource_uptr<archetype_column_base>;
+
+    class archetype_column_base {
+    public:
+        virtual ~archetype_column_base() = default;
+        virtual archetype_column_uptr create_empty() const = 0;
+        virtual archetype_column_uptr clone() const = 0;
+        virtual void reserve(std::size_t capacity) = 0;
+        virtual void move_back_from(archetype_column_base& from, std::size_t row) = 0;
+        virtual void copy_back_from(const archetype_column_base& from, std::size_t row) = 0;
+        virtual void swap_remove(std::size_t row) noexcept = 0;
+        virtual void pop_back() noexcept = 0;
+        virtual void shrink_to_fit() = 0;
+        virtual std::size_t value_size() const noexcept = 0;
+        virtual std::size_t memory_usage() const noexcept = 0;
+    };
+
+    template < typename T >
+    class archetype_column final : public archetype_column_base {
+    public:
+        explicit archetype_column(memory_resource* resource)
+        : values_(resource_allocator<T>(resource)) {}
+
+        archetype_column(const archetype_column& other)
+        : archetype_column_base()
+        , values_(other.values_) {}
+
+        archetype_column_uptr create_empty() const override {
+            memory_resource* resource = values_.get_allocator().resource();
+            return allocate_unique<archetype_column>(resource, resource);
+        }
+
+        archetype_column_uptr clone() const override {
+            memory_resource* resource = values_.get_allocator().resource();
+            return allocate_unique<archetype_column>(resource, *this);
+        }
+
+        void reserve(std::size_t capacity) override {
+            values_.reserve(capacity);
+        }
+
+        void move_back_from(archetype_column_base& from, std::size_t row) override {
+            auto& from_values = static_cast<archetype_column&>(from).values_;
+            values_.push_back(std::move(from_values[row]));
+        }
+
+        void copy_back_from(const archetype_column_base& from, std::size_t row) override {
+            const auto& from_values = static_cast<const archetype_column&>(from).values_;
+            values_.push_back(from_values[row]);
+        }
+
+        void swap_remove(std::size_t row) noexcept override {
+            if ( row != values_.size() - 1u ) {
+                using std::swap;
+                swap(values_[row], values_.back());
+            }
+            values_.pop_back();
+        }
+
+        void pop_back() noexcept override {
+            values_.pop_back();
+        }
+
+        void shrink_to_fit() override {
+            values_.shrink_to_fit();
+        }
+
+        std::size_t value_size() const noexcept override {
+            return sizeof(T);
+        }
+
+        std::size_t memory_usage() const noexcept override {
+            return values_.capacity() * sizeof(T);
+        }
+
+        archetype_vector<T>& values() noexcept {
+            return values_;
+        }
+
+        const archetype_vector<T>& values() const noexcept {
+            return values_;
+        }
+    private:
+        archetype_vector<T> values_;
+    };
+
+    class archetype final {
+    public:
+        explicit archetype(memory_resource* resource)
+        : add_edges(sparse_indexer<family_id>(), resource)
+        , remove_edges(sparse_indexer<family_id>(), resource)
+        , families_(resource)
+        , columns_(resource)
+        , entities_(resource) {}
+
+        archetype(
+            memory_resource* resource,
+            archetype_vector<family_id> families,
+            archetype_vector<archetype_column_uptr> columns)
+        : add_edges(sparse_indexer<family_id>(), resource)
+        , remove_edges(sparse_indexer<family_id>(), resource)
+        , families_(std::move(families))
+        , columns_(std::move(columns))
+        , entities_(resource) {}
+
+        archetype(const archetype& other)
+        : add_edges(other.add_edges)
+        , remove_edges(other.remove_edges)
+        , families_(other.families_)
+        , columns_(other.columns_.get_allocator())
+        , entities_(other.entities_) {
+            columns_.reserve(other.columns_.size());
+            for ( const archetype_column_uptr& c : other.columns_ ) {
+                columns_.push_back(c->clone());
+            }
+        }
+
+        archetype& operator=(const archetype&) = delete;
+
+        const archetype_vector<family_id>& families() const noexcept {
+            return families_;
+        }
+
+        std::size_t column_count() const noexcept {
+            return columns_.size();
+        }
+
+        // returns column_count() if the family isn't in the archetype
+        std::size_t find_column(family_id family) const noexcept {
+            const auto iter = std::lower_bound(families_.begin(), families_.end(), family);
+            return iter != families_.end() && *iter == family
+                ? static_cast<std::size_t>(iter - families_.begin())
+                : columns_.size();
+        }
+
+        archetype_column_base& column(std::size_t index) noexcept {
+            assert(index < columns_.size());
+            return *columns_[index];
+        }
+
+        const archetype_column_base& column(std::size_t index) const noexcept {
+            assert(index < columns_.size());
+            return *columns_[index];
+        }
+
+        template < typename T >
+        archetype_vector<T>& values(std::size_t index) noexcept {
+            return static_cast<archetype_column<T>&>(column(index)).values();
+        }
+
+        template < typename T >
+        const archetype_vector<T>& values(std::size_t index) const noexcept {
+            return static_cast<const archetype_column<T>&>(column(index)).values();
+        }
+
+        std::size_t size() const noexcept {
+            return entities_.size();
+        }
+
+        entity_id entity_at(std::size_t row) const noexcept {
+            assert(row < entities_.size());
+            return entities_[row];
+        }
+
+        std::size_t capacity() const noexcept {
+            return entities_.capacity();
         }
 
-        std::size_t memory_usage() const noexcept {
-            return keys_.memory_usage()
-                + values_.capacity() * sizeof(values_[0]);
+        std::size_t row_size() const noexcept {
+            std::size_t size = sizeof(entity_id);
+            for ( const archetype_column_uptr& c : columns_ ) {
+                size += c->value_size();
+            }
+            return size;
         }
-    private:
-        sparse_set<K, Indexer> keys_;
-        std::vector<T> values_;
-    };
 
-    template < typename K
-             , typename T
-             , typename Indexer >
-    void swap(
-        sparse_map<K, T, Indexer>& l,
-        sparse_map<K, T, Indexer>& r) noexcept
-    {
-        l.swap(r);
-    }
-}
+        void reserve(std::size_t min_capacity, const growth_policy& growth = growth_policy()) {
+            if ( entities_.capacity() >= min_capacity ) {
+                return;
+            }
+            const std::size_t capacity = next_capacity_size(
+                entities_.capacity(),
+                min_capacity,
+                entities_.max_size(),
+                growth);
+            for ( const archetype_column_uptr& c : columns_ ) {
+                c->reserve(capacity);
+            }
+            entities_.reserve(capacity);
+        }
 
-// -----------------------------------------------------------------------------
-//
-// detail::entity_id_indexer
-//
-// -----------------------------------------------------------------------------
+        void push_back(entity_id id) noexcept {
+            assert(entities_.size() < entities_.capacity());
+            entities_.push_back(id);
+        }
 
-namespace ecs_hpp::detail
-{
-    struct entity_id_indexer final {
-        std::size_t operator()(entity_id id) const noexcept {
-            return entity_id_index(id);
+        // returns the entity moved into the erased row
+        entity_id swap_remove(std::size_t row) noexcept {
+            assert(row < entities_.size());
+            for ( const archetype_column_uptr& c : columns_ ) {
+                c->swap_remove(row);
+            }
+            entities_[row] = entities_.back();
+            entities_.pop_back();
+            return row < entities_.size()
+                ? entities_[row]
+                : entity_id{};
         }
-    };
-}
 
-// -----------------------------------------------------------------------------
-//
-// detail::component_storage
-//
-// -----------------------------------------------------------------------------
+        void shrink_to_fit() {
+            for ( const archetype_column_uptr& c : columns_ ) {
+                c->shrink_to_fit();
+            }
+            entities_.shrink_to_fit();
+        }
 
-namespace ecs_hpp::detail
-{
-    class component_storage_base {
+        std::size_t memory_usage() const noexcept {
+            std::size_t usage = sizeof(archetype)
+                + families_.capacity() * sizeof(family_id)
+                + columns_.capacity() * sizeof(archetype_column_uptr)
+                + entities_.capacity() * sizeof(entity_id)
+                + add_edges.memory_usage()
+                + remove_edges.memory_usage();
+            for ( const archetype_column_uptr& c : columns_ ) {
+                usage += c->memory_usage();
+            }
+            return usage;
+        }
     public:
-        virtual ~component_storage_base() = default;
-        virtual bool remove(entity_id id) noexcept = 0;
-        virtual bool has(entity_id id) const noexcept = 0;
-        virtual void clone(entity_id from, entity_id to) = 0;
-        virtual std::size_t memory_usage() const noexcept = 0;
+        archetype_edges add_edges;
+        archetype_edges remove_edges;
+    private:
+        archetype_vector<family_id> families_;
+        archetype_vector<archetype_column_uptr> columns_;
+        archetype_vector<entity_id> entities_;
     };
 
-    template < typename T, bool E = std::is_empty_v<T> >
-    class component_storage final : public component_storage_base {
+    // entities with the same set of components share an archetype, the
+    // first archetype has no components and never holds any entity
+    class archetype_world final {
     public:
-        component_storage(registry& owner)
-        : owner_(owner) {}
+        explicit archetype_world(memory_resource* resource)
+        : resource_(resource)
+        , archetypes_(resource)
+        , locations_(entity_id_indexer(), resource) {
+            archetypes_.push_back(allocate_unique<archetype>(resource_, resource_));
+        }
+
+        archetype_world(const archetype_world& other)
+        : resource_(other.resource_)
+        , growth_(other.growth_)
+        , growth_observer_(other.growth_observer_)
+        , archetypes_(other.resource_)
+        , locations_(other.locations_) {
+            archetypes_.reserve(other.archetypes_.size());
+            for ( const auto& a : other.archetypes_ ) {
+                archetypes_.push_back(allocate_unique<archetype>(resource_, *a));
+            }
+        }
 
-        template < typename... Args >
-        T& assign(entity_id id, Args&&... args) {
-            if ( T* value = components_.find(id) ) {
-                *value = T{std::forward<Args>(args)...};
+        archetype_world& operator=(const archetype_world&) = delete;
+
+        template < typename T, typename... Args >
+        component_reference<T> assign(entity_id id, Args&&... args) {
+            if ( auto value = find_assignable<T>(id) ) {
+                assign_value<T>(*value, std::forward<Args>(args)...);
                 return *value;
             }
-            assert(!components_locker_.is_locked());
-            return *components_.insert(id, T{std::forward<Args>(args)...}).first;
+            assert(!locker_.is_locked());
+            return insert_<T>(id, std::forward<Args>(args)...);
         }
 
-        template < typename... Args >
-        T& ensure(entity_id id, Args&&... args) {
-            if ( T* value = components_.find(id) ) {
+        template < typename T, typename... Args >
+        component_reference<T> ensure(entity_id id, Args&&... args) {
+            if ( component_pointer<T> value = find<T>(id) ) {
                 return *value;
             }
-            assert(!components_locker_.is_locked());
-            return *components_.insert(id, T{std::forward<Args>(args)...}).first;
+            assert(!locker_.is_locked());
+            return insert_<T>(id, std::forward<Args>(args)...);
         }
 
+        template < typename T >
         bool exists(entity_id id) const noexcept {
-            return components_.has(id);
+            const location* loc = locations_.find(id);
+            return loc
+                && archetypes_[loc->archetype]->find_column(type_family<T>::id())
+                    < archetypes_[loc->archetype]->column_count();
         }
 
-        bool remove(entity_id id) noexcept override {
-            assert(!components_locker_.is_locked());
-            return components_.unordered_erase(id);
+        template < typename T >
+        bool remove(entity_id id) {
+            assert(!locker_.is_locked());
+            if ( !exists<T>(id) ) {
+                return false;
+            }
+            const location* loc = locations_.find(id);
+            const std::size_t to = find_or_create_without_(loc->archetype, type_family<T>::id());
+            if ( to == 0u ) {
+                remove_all(id);
+            } else {
+                transfer_(id, to, [](archetype_column_base&){
+                    assert(false && "unexpected internal error");
+                });
+            }
+            return true;
         }
 
-        std::size_t remove_all() noexcept {
-            assert(!components_locker_.is_locked());
-            const std::size_t count = components_.size();
-            components_.clear();
+        std::size_t remove_all(entity_id id) noexcept {
+            assert(!locker_.is_locked());
+            const location* loc = locations_.find(id);
+            if ( !loc ) {
+                return 0u;
+            }
+            archetype& a = *archetypes_[loc->archetype];
+            erase_row_(a, loc->row);
+            locations_.unordered_erase(id);
+            return a.column_count();
+        }
+
+        template < typename T >
+        std::size_t remove_all() {
+            assert(!locker_.is_locked());
+            std::size_t count = 0u;
+            for ( std::size_t i = 0; i < archetypes_.size(); ++i ) {
+                archetype& a = *archetypes_[i];
+                if ( a.find_column(type_family<T>::id()) == a.column_count() ) {
+                    continue;
+                }
+                for ( ; a.size(); ++count ) {
+                    remove<T>(a.entity_at(a.size() - 1u));
+                }
+            }
             return count;
         }
 
-        T* find(entity_id id) noexcept {
-            return components_.find(id);
+        // shared components are read-only through `find`,
+        // but the tables keep a copy of them per entity
+        template < typename T >
+        auto find_assignable(entity_id id) noexcept {
+            if constexpr ( is_shared_component_v<T> ) {
+                const location* loc = locations_.find(id);
+                if ( !loc ) {
+                    return static_cast<T*>(nullptr);
+                }
+                archetype& a = *archetypes_[loc->archetype];
+                const std::size_t column = a.find_column(type_family<T>::id());
+                return column < a.column_count()
+                    ? &a.values<T>(column)[loc->row]
+                    : nullptr;
+            } else {
+                return find<T>(id);
+            }
         }
 
-        const T* find(entity_id id) const noexcept {
-            return components_.find(id);
+        template < typename T >
+        component_pointer<T> find(entity_id id) noexcept {
+            const location* loc = locations_.find(id);
+            if ( !loc ) {
+                return nullptr;
+            }
+            archetype& a = *archetypes_[loc->archetype];
+            const std::size_t column = a.find_column(type_family<T>::id());
+            return column < a.column_count()
+                ? component_address(to_component_reference(a.values<T>(column)[loc->row]))
+                : nullptr;
+        }
+
+        template < typename T >
+        const_component_pointer<T> find(entity_id id) const noexcept {
+            const location* loc = locations_.find(id);
+            if ( !loc ) {
+                return nullptr;
+            }
+            const archetype& a = *archetypes_[loc->archetype];
+            const std::size_t column = a.find_column(type_family<T>::id());
+            return column < a.column_count()
+                ? component_address(to_component_reference(a.values<T>(column)[loc->row]))
+                : nullptr;
         }
 
+        template < typename T >
         std::size_t count() const noexcept {
-            return components_.size();
+            std::size_t count = 0u;
+            for ( const auto& a : archetypes_ ) {
+                if ( a->find_column(type_family<T>::id()) < a->column_count() ) {
+                    count += a->size();
+                }
+            }
+            return count;
         }
 
-        bool has(entity_id id) const noexcept override {
-            return components_.has(id);
+        std::size_t component_count(entity_id id) const noexcept {
+            const location* loc = locations_.find(id);
+            return loc
+                ? archetypes_[loc->archetype]->column_count()
+                : 0u;
         }
 
-        void clone(entity_id from, entity_id to) override {
-            if ( const T* c = find(from) ) {
-                assign(to, *c);
+        void clone(entity_id from, entity_id to) {
+            assert(!locker_.is_locked());
+            assert(!locations_.has(to));
+            const location* from_loc = locations_.find(from);
+            if ( !from_loc ) {
+                return;
+            }
+            const location loc = *from_loc;
+            archetype& a = *archetypes_[loc.archetype];
+            reserve_row_(a);
+            locations_.insert(to, location{loc.archetype, a.size()});
+            std::size_t copied = 0u;
+            try {
+                for ( ; copied < a.column_count(); ++copied ) {
+                    a.column(copied).copy_back_from(a.column(copied), loc.row);
+                }
+            } catch (...) {
+                for ( std::size_t i = 0; i < copied; ++i ) {
+                    a.column(i).pop_back();
+                }
+                locations_.unordered_erase(to);
+                throw;
             }
+            a.push_back(to);
         }
 
-        template < typename F >
-        void for_each_component(F&& f) {
-            detail::incremental_lock_guard lock(components_locker_);
-            for ( const entity_id id : components_ ) {
-                f(id, components_.get(id));
+        template < typename... Ts, typename F >
+        void for_each(F&& f) {
+            detail::incremental_lock_guard lock(locker_);
+            for ( const auto& a : archetypes_ ) {
+                for_each_(*a, f, std::index_sequence_for<Ts...>(), type_list_<Ts...>());
             }
         }
 
-        template < typename F >
-        void for_each_component(F&& f) const {
-            detail::incremental_lock_guard lock(components_locker_);
-            for ( const entity_id id : components_ ) {
-                f(id, components_.get(id));
+        template < typename... Ts, typename F >
+        void for_each(F&& f) const {
+            detail::incremental_lock_guard lock(locker_);
+            for ( const auto& a : archetypes_ ) {
+                for_each_(std::as_const(*a), f, std::index_sequence_for<Ts...>(), type_list_<Ts...>());
             }
         }
 
-        std::size_t memory_usage() const noexcept override {
-            return components_.memory_usage();
+        void set_growth(const growth_policy& policy, growth_observer* observer) noexcept {
+            growth_ = policy;
+            growth_observer_ = observer;
         }
-    private:
-        registry& owner_;
-        mutable detail::incremental_locker components_locker_;
-        detail::sparse_map<entity_id, T, entity_id_indexer> components_;
-    };
-
-    template < typename T >
-    class component_storage<T, true> final : public component_storage_base {
-    public:
-        component_storage(registry& owner)
-        : owner_(owner) {}
 
-        template < typename... Args >
-        T& assign(entity_id id, Args&&...) {
-            if ( components_.has(id) ) {
-                return empty_value_;
+        void shrink_to_fit() {
+            assert(!locker_.is_locked());
+            for ( const auto& a : archetypes_ ) {
+                a->shrink_to_fit();
             }
-            assert(!components_locker_.is_locked());
-            components_.insert(id);
-            return empty_value_;
+            locations_.shrink_to_fit();
         }
 
-        template < typename... Args >
-        T& ensure(entity_id id, Args&&...) {
-            if ( components_.has(id) ) {
-                return empty_value_;
+        std::size_t memory_usage() const noexcept {
+            std::size_t usage = archetypes_.capacity() * sizeof(archetype_uptr)
+                + locations_.memory_usage();
+            for ( const auto& a : archetypes_ ) {
+                usage += a->memory_usage();
             }
-            assert(!components_locker_.is_locked());
-            components_.insert(id);
-            return empty_value_;
+            return usage;
         }
 
-        bool exists(entity_id id) const noexcept {
-            return components_.has(id);
+        template < typename T >
+        std::size_t memory_usage() const noexcept {
+            std::size_t usage = 0u;
+            for ( const auto& a : archetypes_ ) {
+                const std::size_t column = a->find_column(type_family<T>::id());
+                if ( column < a->column_count() ) {
+                    usage += a->column(column).memory_usage();
+                }
+            }
+            return usage;
         }
+    private:
+        struct location final {
+            std::size_t archetype{0u};
+            std::size_t row{0u};
+        };
 
-        bool remove(entity_id id) noexcept override {
-            assert(!components_locker_.is_locked());
-            return components_.unordered_erase(id);
-        }
+        template < typename... Ts >
+        struct type_list_ {};
 
-        std::size_t remove_all() noexcept {
-            assert(!components_locker_.is_locked());
-            const std::size_t count = components_.size();
-            components_.clear();
-            return count;
+        using archetype_uptr = resource_uptr<archetype>;
+    private:
+        template < typename A, typename F, std::size_t... Is, typename... Ts >
+        static void for_each_(A& a, F& f, std::index_sequence<Is...>, type_list_<Ts...>) {
+            const std::size_t columns[] = {a.find_column(type_family<Ts>::id())...};
+            if ( !a.size() || (... || (columns[Is] == a.column_count())) ) {
+                return;
+            }
+            // the matched columns are walked in lockstep without any lookups
+            const auto values = std::make_tuple(a.template values<Ts>(columns[Is]).data()...);
+            for ( std::size_t row = 0, size = a.size(); row < size; ++row ) {
+                f(a.entity_at(row), to_component_reference(std::get<Is>(values)[row])...);
+            }
         }
 
-        T* find(entity_id id) noexcept {
-            return components_.has(id)
-                ? &empty_value_
-                : nullptr;
+        template < typename T, typename... Args >
+        component_reference<T> insert_(entity_id id, Args&&... args) {
+            // the arguments may refer to a column that is reallocated by the transfer
+            T value = make_value<T>(std::forward<Args>(args)...);
+            const location* loc = locations_.find(id);
+            const std::size_t to = find_or_create_with_<T>(loc ? loc->archetype : 0u);
+            transfer_(id, to, [&value](archetype_column_base& c){
+                static_cast<archetype_column<T>&>(c).values().push_back(std::move(value));
+            });
+            return *find<T>(id);
         }
 
-        const T* find(entity_id id) const noexcept {
-            return components_.has(id)
-                ? &empty_value_
-                : nullptr;
-        }
+        // moves the entity row to the archetype `to`, the columns missing in
+        // the old archetype are filled by `push_missing`
+        template < typename F >
+        void transfer_(entity_id id, std::size_t to, F&& push_missing) {
+            archetype& ta = *archetypes_[to];
+            reserve_row_(ta);
+
+            location* loc = locations_.find(id);
+            const bool inserted = !loc;
+            if ( inserted ) {
+                loc = locations_.insert(id, location{}).first;
+            }
 
-        std::size_t count() const noexcept {
-            return components_.size();
+            archetype& fa = *archetypes_[loc->archetype];
+            std::size_t pushed = 0u;
+            try {
+                for ( ; pushed < ta.column_count(); ++pushed ) {
+                    const std::size_t column = fa.find_column(ta.families()[pushed]);
+                    if ( column < fa.column_count() ) {
+                        ta.column(pushed).move_back_from(fa.column(column), loc->row);
+                    } else {
+                        push_missing(ta.column(pushed));
+                    }
+                }
+            } catch (...) {
+                for ( std::size_t i = 0; i < pushed; ++i ) {
+                    ta.column(i).pop_back();
+                }
+                if ( inserted ) {
+                    locations_.unordered_erase(id);
+                }
+                throw;
+            }
+            ta.push_back(id);
+
+            if ( !inserted ) {
+                erase_row_(fa, loc->row);
+            }
+            *loc = location{to, ta.size() - 1u};
         }
 
-        bool has(entity_id id) const noexcept override {
-            return components_.has(id);
+        void erase_row_(archetype& a, std::size_t row) noexcept {
+            const std::size_t last_row = a.size() - 1u;
+            const entity_id moved = a.swap_remove(row);
+            if ( row != last_row ) {
+                locations_.find(moved)->row = row;
+            }
         }
 
-        void clone(entity_id from, entity_id to) override {
-            if ( const T* c = find(from) ) {
-                assign(to, *c);
+        template < typename T >
+        std::size_t find_or_create_with_(std::size_t from) {
+            const family_id family = type_family<T>::id();
+            if ( const std::size_t* to = archetypes_[from]->add_edges.find(family) ) {
+                return *to;
+            }
+            const archetype& fa = *archetypes_[from];
+            archetype_vector<family_id> families = fa.families();
+            families.insert(
+                std::lower_bound(families.begin(), families.end(), family),
+                family);
+            std::size_t to = find_archetype_(families);
+            if ( to == archetypes_.size() ) {
+                archetype_vector<archetype_column_uptr> columns(resource_);
+                columns.reserve(families.size());
+                for ( const family_id f : families ) {
+                    columns.push_back(f == family
+                        ? allocate_unique<archetype_column<T>>(resource_, resource_)
+                        : fa.column(fa.find_column(f)).create_empty());
+                }
+                to = create_archetype_(std::move(families), std::move(columns));
             }
+            link_archetypes_(from, to, family);
+            return to;
         }
 
-        template < typename F >
-        void for_each_component(F&& f) {
-            detail::incremental_lock_guard lock(components_locker_);
-            for ( const entity_id id : components_ ) {
-                f(id, empty_value_);
+        std::size_t find_or_create_without_(std::size_t from, family_id family) {
+            if ( const std::size_t* to = archetypes_[from]->remove_edges.find(family) ) {
+                return *to;
+            }
+            const archetype& fa = *archetypes_[from];
+            archetype_vector<family_id> families = fa.families();
+            families.erase(std::lower_bound(families.begin(), families.end(), family));
+            std::size_t to = find_archetype_(families);
+            if ( to == archetypes_.size() ) {
+                archetype_vector<archetype_column_uptr> columns(resource_);
+                columns.reserve(families.size());
+                for ( const family_id f : families ) {
+                    columns.push_back(fa.column(fa.find_column(f)).create_empty());
+                }
+                to = create_archetype_(std::move(families), std::move(columns));
             }
+            link_archetypes_(to, from, family);
+            return to;
         }
 
-        template < typename F >
-        void for_each_component(F&& f) const {
-            detail::incremental_lock_guard lock(components_locker_);
-            for ( const entity_id id : components_ ) {
-                f(id, empty_value_);
+        std::size_t find_archetype_(const archetype_vector<family_id>& families) const noexcept {
+            for ( std::size_t i = 0; i < archetypes_.size(); ++i ) {
+                if ( archetypes_[i]->families() == families ) {
+                    return i;
+                }
             }
+            return archetypes_.size();
         }
 
-        std::size_t memory_usage() const noexcept override {
-            return components_.memory_usage();
+        std::size_t create_archetype_(
+            archetype_vector<family_id>&& families,
+            archetype_vector<archetype_column_uptr>&& columns)
+        {
+            archetypes_.push_back(allocate_unique<archetype>(
+                resource_,
+                resource_,
+                std::move(families),
+                std::move(columns)));
+            return archetypes_.size() - 1u;
+        }
+
+        void link_archetypes_(std::size_t smaller, std::size_t larger, family_id family) {
+            archetypes_[smaller]->add_edges.insert(family, larger);
+            archetypes_[larger]->remove_edges.insert(family, smaller);
+        }
+
+        void reserve_row_(archetype& a) {
+            const std::size_t old_capacity = a.capacity();
+            a.reserve(a.size() + 1u, growth_);
+            if ( growth_observer_ && a.capacity() != old_capacity ) {
+                growth_observer_->on_growth(growth_event{
+                    0u, a.row_size(), old_capacity, a.capacity()});
+            }
         }
     private:
-        registry& owner_;
-        static T empty_value_;
-        mutable detail::incremental_locker components_locker_;
-        detail::sparse_set<entity_id, entity_id_indexer> components_;
+        memory_resource* resource_{nullptr};
+        growth_policy growth_;
+        growth_observer* growth_observer_{nullptr};
+        archetype_vector<archetype_uptr> archetypes_;
+        mutable detail::incremental_locker locker_;
+        sparse_map<
+            entity_id,
+            location,
+            entity_id_indexer,
+            entity_id_sparse_index,
+            resource_allocator<location>> locations_;
     };
-
-    template < typename T >
-    T component_storage<T, true>::empty_value_;
 }
 
 // -----------------------------------------------------------------------------
@@ -878,10 +4691,13 @@ namespace ecs_hpp
         bool valid() const noexcept;
 
         template < typename T, typename... Args >
-        T& assign_component(Args&&... args);
+        component_reference<T> assign_component(Args&&... args);
 
         template < typename T, typename... Args >
-        T& ensure_component(Args&&... args);
+        component_reference<T> ensure_component(Args&&... args);
+
+        template < typename T, typename F, typename... Args >
+        component_reference<T> update_component(F&& f, Args&&... args);
 
         template < typename T >
         bool remove_component() noexcept;
@@ -892,26 +4708,26 @@ namespace ecs_hpp
         std::size_t remove_all_components() noexcept;
 
         template < typename T >
-        T& get_component();
+        component_reference<T> get_component();
 
         template < typename T >
-        const T& get_component() const;
+        const_component_reference<T> get_component() const;
 
         template < typename T >
-        T* find_component() noexcept;
+        component_pointer<T> find_component() noexcept;
 
         template < typename T >
-        const T* find_component() const noexcept;
+        const_component_pointer<T> find_component() const noexcept;
 
         template < typename... Ts >
-        std::tuple<Ts&...> get_components();
+        std::tuple<component_reference<Ts>...> get_components();
         template < typename... Ts >
-        std::tuple<const Ts&...> get_components() const;
+        std::tuple<const_component_reference<Ts>...> get_components() const;
 
         template < typename... Ts >
-        std::tuple<Ts*...> find_components() noexcept;
+        std::tuple<component_pointer<Ts>...> find_components() noexcept;
         template < typename... Ts >
-        std::tuple<const Ts*...> find_components() const noexcept;
+        std::tuple<const_component_pointer<Ts>...> find_components() const noexcept;
 
         std::size_t component_count() const noexcept;
     private:
@@ -970,16 +4786,16 @@ namespace ecs_hpp
         bool exists_component() const noexcept;
 
         template < typename T >
-        const T& get_component() const;
+        const_component_reference<T> get_component() const;
 
         template < typename T >
-        const T* find_component() const noexcept;
+        const_component_pointer<T> find_component() const noexcept;
 
         template < typename... Ts >
-        std::tuple<const Ts&...> get_components() const;
+        std::tuple<const_component_reference<Ts>...> get_components() const;
 
         template < typename... Ts >
-        std::tuple<const Ts*...> find_components() const noexcept;
+        std::tuple<const_component_pointer<Ts>...> find_components() const noexcept;
 
         std::size_t component_count() const noexcept;
     private:
@@ -1034,24 +4850,27 @@ namespace ecs_hpp
         bool exists() const noexcept;
 
         template < typename... Args >
-        T& assign(Args&&... args);
+        component_reference<T> assign(Args&&... args);
 
         template < typename... Args >
-        T& ensure(Args&&... args);
+        component_reference<T> ensure(Args&&... args);
+
+        template < typename F, typename... Args >
+        component_reference<T> update(F&& f, Args&&... args);
 
         bool remove() noexcept;
 
-        T& get();
-        const T& get() const;
+        component_reference<T> get();
+        const_component_reference<T> get() const;
 
-        T* find() noexcept;
-        const T* find() const noexcept;
+        component_pointer<T> find() noexcept;
+        const_component_pointer<T> find() const noexcept;
 
-        T& operator*();
-        const T& operator*() const;
+        component_reference<T> operator*();
+        const_component_reference<T> operator*() const;
 
-        T* operator->() noexcept;
-        const T* operator->() const noexcept;
+        component_pointer<T> operator->() noexcept;
+        const_component_pointer<T> operator->() const noexcept;
 
         explicit operator bool() const noexcept;
     private:
@@ -1107,11 +4926,11 @@ namespace ecs_hpp
         bool valid() const noexcept;
         bool exists() const noexcept;
 
-        const T& get() const;
-        const T* find() const noexcept;
+        const_component_reference<T> get() const;
+        const_component_pointer<T> find() const noexcept;
 
-        const T& operator*() const;
-        const T* operator->() const noexcept;
+        const_component_reference<T> operator*() const;
+        const_component_pointer<T> operator->() const noexcept;
         explicit operator bool() const noexcept;
     private:
         const_entity owner_;
@@ -1151,13 +4970,34 @@ namespace ecs_hpp
 {
     namespace detail
     {
+        class instantiator_base;
+        using instantiator_uptr = resource_uptr<instantiator_base>;
+
+        class instantiator_base {
+        public:
+            virtual ~instantiator_base() = default;
+            virtual void instantiate(registry& owner, const entity_id* first, const entity_id* last) const = 0;
+        };
+
+        // `V` is a shared handle for shared components
+        template < typename T, typename V = T >
+        class typed_instantiator final : public instantiator_base {
+        public:
+            typed_instantiator(registry& owner, V&& value);
+            void instantiate(registry& owner, const entity_id* first, const entity_id* last) const override;
+        private:
+            std::size_t slot_{0u};
+            V value_;
+        };
+
         class applier_base;
-        using applier_uptr = std::unique_ptr<applier_base>;
+        using applier_uptr = resource_uptr<applier_base>;
 
         class applier_base {
         public:
             virtual ~applier_base() = default;
-            virtual applier_uptr clone() const = 0;
+            virtual applier_uptr clone(memory_resource* resource) const = 0;
+            virtual instantiator_uptr compile(registry& owner, memory_resource* resource) const = 0;
             virtual void apply_to_entity(entity& ent, bool override) const = 0;
         };
 
@@ -1167,12 +5007,25 @@ namespace ecs_hpp
             virtual void apply_to_component(T& component) const = 0;
         };
 
+        template < typename T >
+        class shared_applier final : public typed_applier<T> {
+        public:
+            shared_applier(const shared_handle<T>& value);
+            applier_uptr clone(memory_resource* resource) const override;
+            instantiator_uptr compile(registry& owner, memory_resource* resource) const override;
+            void apply_to_entity(entity& ent, bool override) const override;
+            void apply_to_component(T& component) const override;
+        private:
+            shared_handle<T> value_;
+        };
+
         template < typename T, typename... Args >
         class typed_applier_with_args final : public typed_applier<T> {
         public:
             typed_applier_with_args(std::tuple<Args...>&& args);
             typed_applier_with_args(const std::tuple<Args...>& args);
-            applier_uptr clone() const override;
+            applier_uptr clone(memory_resource* resource) const override;
+            instantiator_uptr compile(registry& owner, memory_resource* resource) const override;
             void apply_to_entity(entity& ent, bool override) const override;
             void apply_to_component(T& component) const override;
         private:
@@ -1185,6 +5038,8 @@ namespace ecs_hpp
         prototype() = default;
         ~prototype() noexcept = default;
 
+        explicit prototype(memory_resource* resource);
+
         prototype(const prototype& other);
         prototype& operator=(const prototype& other);
 
@@ -1194,6 +5049,7 @@ namespace ecs_hpp
         void clear() noexcept;
         bool empty() const noexcept;
         void swap(prototype& other) noexcept;
+        memory_resource* resource() const noexcept;
 
         template < typename T >
         bool has_component() const noexcept;
@@ -1210,12 +5066,38 @@ namespace ecs_hpp
         bool apply_to_component(T& component) const;
         void apply_to_entity(entity& ent, bool override) const;
     private:
+        friend class compiled_prototype;
         detail::sparse_map<
             family_id,
-            detail::applier_uptr> appliers_;
+            detail::applier_uptr,
+            detail::sparse_indexer<family_id>,
+            detail::default_sparse_index_t<family_id>,
+            detail::resource_allocator<detail::applier_uptr>> appliers_;
     };
 
     void swap(prototype& l, prototype& r) noexcept;
+
+    // the prototype components are built once and copied into the storages
+    // of `owner`, which are resolved at compilation
+    class compiled_prototype final {
+    public:
+        compiled_prototype(registry& owner, const prototype& proto);
+
+        compiled_prototype(const compiled_prototype&) = delete;
+        compiled_prototype& operator=(const compiled_prototype&) = delete;
+
+        compiled_prototype(compiled_prototype&&) noexcept = default;
+        compiled_prototype& operator=(compiled_prototype&&) noexcept = default;
+
+        registry& owner() const noexcept;
+        bool empty() const noexcept;
+        std::size_t component_count() const noexcept;
+    private:
+        friend class registry;
+        registry* owner_{nullptr};
+        using instantiator_uptr = detail::instantiator_uptr;
+        std::vector<instantiator_uptr, detail::resource_allocator<instantiator_uptr>> instantiators_;
+    };
 }
 
 // -----------------------------------------------------------------------------
@@ -1277,6 +5159,7 @@ namespace ecs_hpp
     class feature final {
     public:
         feature() = default;
+        explicit feature(memory_resource* resource);
 
         feature(const feature&) = delete;
         feature& operator=(const feature&) = delete;
@@ -1302,7 +5185,8 @@ namespace ecs_hpp
         feature& process_event(registry& owner, const Event& event);
     private:
         bool disabled_{false};
-        std::vector<std::unique_ptr<system<>>> systems_;
+        using system_uptr = detail::resource_uptr<system<>>;
+        std::vector<system_uptr, detail::resource_allocator<system_uptr>> systems_;
         mutable detail::incremental_locker systems_locker_;
     };
 }
@@ -1359,7 +5243,11 @@ namespace ecs_hpp
             const registry* owner_{nullptr};
         };
     public:
-        registry() = default;
+        registry();
+        explicit registry(memory_resource* resource);
+        explicit registry(
+            registry_backend backend,
+            memory_resource* resource = new_delete_resource());
 
         registry(const registry& other) = delete;
         registry& operator=(const registry& other) = delete;
@@ -1367,6 +5255,13 @@ namespace ecs_hpp
         registry(registry&& other) noexcept = default;
         registry& operator=(registry&& other) noexcept = default;
 
+        // a deep copy of the entities, components, groups and policies, the
+        // storages copy their dense arrays as is, features aren't copied
+        registry fork() const;
+
+        registry_backend backend() const noexcept;
+        memory_resource* resource() const noexcept;
+
         entity wrap_entity(const const_uentity& ent) noexcept;
         const_entity wrap_entity(const const_uentity& ent) const noexcept;
 
@@ -1379,14 +5274,58 @@ namespace ecs_hpp
         entity create_entity(const prototype& proto);
         entity create_entity(const const_uentity& proto);
 
+        // recycled ids are written first, then a block of new ones,
+        // the entities not written yet are destroyed if `out` throws
+        template < typename OutputIt >
+        OutputIt create_entities(std::size_t count, OutputIt out);
+        std::vector<entity> create_entities(std::size_t count);
+
+        // every component is copied into all the entities at once
+        entity create_entity(const compiled_prototype& proto);
+        template < typename OutputIt >
+        OutputIt create_entities(const compiled_prototype& proto, std::size_t count, OutputIt out);
+        std::vector<entity> create_entities(const compiled_prototype& proto, std::size_t count);
+
+        // every storage of `proto` components appends all the copies at once
+        template < typename OutputIt >
+        OutputIt clone_entities(const const_uentity& proto, std::size_t count, OutputIt out);
+        std::vector<entity> clone_entities(const const_uentity& proto, std::size_t count);
+
         void destroy_entity(const uentity& ent) noexcept;
+
+        // every storage removes the whole range in one pass,
+        // the entities must be unique and alive
+        template < typename ForwardIt >
+        void destroy_entities(ForwardIt first, ForwardIt last) noexcept;
+
         bool valid_entity(const const_uentity& ent) const noexcept;
 
         template < typename T, typename... Args >
-        T& assign_component(const uentity& ent, Args&&... args);
+        component_reference<T> assign_component(const uentity& ent, Args&&... args);
+
+        template < typename T, typename... Args >
+        component_reference<T> ensure_component(const uentity& ent, Args&&... args);
+
+        // `values` is read once per id, pass move iterators to move the values
+        template < typename T, typename IdIt, typename ValueIt >
+        void assign_components(IdIt ids_first, IdIt ids_last, ValueIt values_first);
+
+        // the existing component is passed to `f` as is, so it keeps its
+        // resources, a missing one is constructed from `args` first
+        template < typename T, typename F, typename... Args >
+        component_reference<T> update_component(const uentity& ent, F&& f, Args&&... args);
+
+        // the component of `from` is shared, or copied if `T` isn't
+        // a shared component or the backend is archetype
+        template < typename T >
+        component_reference<T> share_component(const uentity& to, const const_uentity& from);
+
+        // copy on write, `ent` gets its own instance of a shared component
+        template < typename T >
+        T& detach_component(const uentity& ent);
 
-        template < typename T, typename... Args >
-        T& ensure_component(const uentity& ent, Args&&... args);
+        template < typename T >
+        std::size_t component_use_count(const const_uentity& ent) const noexcept;
 
         template < typename T >
         bool remove_component(const uentity& ent) noexcept;
@@ -1394,30 +5333,36 @@ namespace ecs_hpp
         template < typename T >
         bool exists_component(const const_uentity& ent) const noexcept;
 
+        template < typename... Ts >
+        bool exists_all_components(const const_uentity& ent) const noexcept;
+
+        template < typename... Ts >
+        bool exists_any_components(const const_uentity& ent) const noexcept;
+
         std::size_t remove_all_components(const uentity& ent) noexcept;
 
         template < typename T >
         std::size_t remove_all_components() noexcept;
 
         template < typename T >
-        T& get_component(const uentity& ent);
+        component_reference<T> get_component(const uentity& ent);
         template < typename T >
-        const T& get_component(const const_uentity& ent) const;
+        const_component_reference<T> get_component(const const_uentity& ent) const;
 
         template < typename T >
-        T* find_component(const uentity& ent) noexcept;
+        component_pointer<T> find_component(const uentity& ent) noexcept;
         template < typename T >
-        const T* find_component(const const_uentity& ent) const noexcept;
+        const_component_pointer<T> find_component(const const_uentity& ent) const noexcept;
 
         template < typename... Ts >
-        std::tuple<Ts&...> get_components(const uentity& ent);
+        std::tuple<component_reference<Ts>...> get_components(const uentity& ent);
         template < typename... Ts >
-        std::tuple<const Ts&...> get_components(const const_uentity& ent) const;
+        std::tuple<const_component_reference<Ts>...> get_components(const const_uentity& ent) const;
 
         template < typename... Ts >
-        std::tuple<Ts*...> find_components(const uentity& ent) noexcept;
+        std::tuple<component_pointer<Ts>...> find_components(const uentity& ent) noexcept;
         template < typename... Ts >
-        std::tuple<const Ts*...> find_components(const const_uentity& ent) const noexcept;
+        std::tuple<const_component_pointer<Ts>...> find_components(const const_uentity& ent) const noexcept;
 
         template < typename T >
         std::size_t component_count() const noexcept;
@@ -1434,11 +5379,27 @@ namespace ecs_hpp
         template < typename T, typename F, typename... Opts >
         void for_each_component(F&& f, Opts&&... opts) const;
 
+        // the smallest storage drives the join, but only the first storage
+        // is locked, so `f` may change the other ones whatever their sizes
         template < typename... Ts, typename F, typename... Opts >
         void for_joined_components(F&& f, Opts&&... opts);
         template < typename... Ts, typename F, typename... Opts >
         void for_joined_components(F&& f, Opts&&... opts) const;
 
+        template < typename... Ts >
+        void group();
+
+        template < typename T, typename Compare >
+        void sort_components(Compare&& compare);
+
+        template < typename T, typename Compare >
+        void sort_components_by_id(Compare&& compare);
+
+        // moves the components of `T` owned by entities with `U`
+        // to the front in the order of `U` storage
+        template < typename T, typename U >
+        void sort_components_as();
+
         template < typename Tag, typename... Args >
         feature& assign_feature(Args&&... args);
 
@@ -1465,7 +5426,39 @@ namespace ecs_hpp
 
         template < typename T >
         std::size_t component_memory_usage() const noexcept;
+
+        // entity slots are kept, they hold the versions of destroyed entities
+        void shrink_to_fit();
+
+        template < typename T >
+        void shrink_to_fit();
+
+        // frees the empty storages, the component types keep their slots
+        std::size_t compact() noexcept;
+
+        // the default growth of the registry tables and storages
+        void set_growth_policy(const growth_policy& policy) noexcept;
+
+        // the growth of the storage of `T`, the archetype backend ignores it
+        template < typename T >
+        void set_growth_policy(const growth_policy& policy);
+
+        // reports every reallocation of the registry tables and storages
+        void set_growth_observer(growth_observer* observer) noexcept;
+
+        struct shrink_policy_info {
+            // a storage is shrunk after a removal once its size falls below
+            // the ratio of its capacity, zero disables the automatic shrinking
+            double min_occupancy{0.0};
+            // smaller storages are never shrunk automatically
+            std::size_t min_capacity{1024u};
+        };
+        void set_shrink_policy(const shrink_policy_info& policy) noexcept;
+        const shrink_policy_info& shrink_policy() const noexcept;
     private:
+        struct fork_tag_ {};
+        registry(const registry& other, fork_tag_);
+
         template < typename T >
         detail::component_storage<T>* find_storage_() noexcept;
 
@@ -1475,87 +5468,152 @@ namespace ecs_hpp
         template < typename T >
         detail::component_storage<T>& get_or_create_storage_();
 
-        template < typename F, typename... Opts >
-        void for_joined_components_impl_(
-            std::index_sequence<>,
-            F&& f,
-            Opts&&... opts);
+        std::size_t find_storage_slot_(family_id family) const noexcept;
 
-        template < typename F, typename... Opts >
-        void for_joined_components_impl_(
-            std::index_sequence<>,
-            F&& f,
-            Opts&&... opts) const;
+        entity_id recycle_entity_id_() noexcept;
 
-        template < typename T
-                 , typename... Ts
+        // `fill` gets the ids of the new entities, they're destroyed if it throws
+        template < typename OutputIt, typename F >
+        OutputIt create_entities_(std::size_t count, OutputIt out, F&& fill);
+
+        template < typename T, typename IdIt, typename ValueIt >
+        void assign_components_(IdIt ids_first, IdIt ids_last, ValueIt values_first);
+
+        template < typename T, typename IdIt, typename ValueIt >
+        void assign_storage_components_(
+            detail::component_storage<T>& storage,
+            IdIt ids_first,
+            IdIt ids_last,
+            ValueIt values_first);
+
+        template < typename T >
+        std::size_t instantiation_slot_();
+
+        template < typename T, typename V >
+        void instantiate_components_(
+            std::size_t slot,
+            const V& value,
+            const entity_id* first,
+            const entity_id* last);
+        void release_entity_id_(entity_id id) noexcept;
+        void destroy_entities_(const entity_id* first, const entity_id* last) noexcept;
+
+        void shrink_if_sparse_(detail::component_storage_base& storage) noexcept;
+
+        void assure_signature_(std::size_t row, std::size_t bit);
+
+        template < typename T >
+        detail::component_storage<T>* find_sortable_storage_();
+
+        template < typename... Ts
                  , typename F
                  , typename... Opts
-                 , std::size_t I
                  , std::size_t... Is >
         void for_joined_components_impl_(
-            std::index_sequence<I, Is...>,
+            std::index_sequence<Is...>,
             F&& f,
             Opts&&... opts);
 
-        template < typename T
-                 , typename... Ts
+        template < typename... Ts
                  , typename F
                  , typename... Opts
-                 , std::size_t I
                  , std::size_t... Is >
         void for_joined_components_impl_(
-            std::index_sequence<I, Is...>,
+            std::index_sequence<Is...>,
             F&& f,
             Opts&&... opts) const;
 
-        template < typename T
-                 , typename... Ts
+        template < std::size_t I
                  , typename F
-                 , typename Ss
-                 , typename... Cs >
-        void for_joined_components_impl_(
-            const uentity& e,
+                 , typename... Ts
+                 , typename... Opts >
+        void for_joined_components_driven_(
+            const std::tuple<detail::component_storage<Ts>*...>& ss,
             const F& f,
-            const Ss& ss,
-            Cs&... cs);
+            const Opts&... opts);
 
-        template < typename T
-                 , typename... Ts
+        template < std::size_t I
                  , typename F
-                 , typename Ss
-                 , typename... Cs >
-        void for_joined_components_impl_(
-            const const_uentity& e,
+                 , typename... Ts
+                 , typename... Opts >
+        void for_joined_components_driven_(
+            const std::tuple<const detail::component_storage<Ts>*...>& ss,
             const F& f,
-            const Ss& ss,
-            const Cs&... cs) const;
+            const Opts&... opts) const;
 
-        template < typename F, typename... Cs >
-        void for_joined_components_impl_(
-            const uentity& e,
+        template < std::size_t I
+                 , typename F
+                 , typename... Ts
+                 , typename... Opts >
+        void for_joined_components_grouped_(
+            const std::tuple<detail::component_storage<Ts>*...>& ss,
             const F& f,
-            const std::tuple<>& ss,
-            Cs&... cs);
+            const Opts&... opts);
 
-        template < typename F, typename... Cs >
-        void for_joined_components_impl_(
-            const const_uentity& e,
+        template < std::size_t I
+                 , typename F
+                 , typename... Ts
+                 , typename... Opts >
+        void for_joined_components_grouped_(
+            const std::tuple<const detail::component_storage<Ts>*...>& ss,
             const F& f,
-            const std::tuple<>& ss,
-            const Cs&... cs) const;
+            const Opts&... opts) const;
+
+        template < typename... Args >
+        feature make_feature_(Args&&... args) const;
+
+        friend entity_id detail::find_alive_entity_id(const registry& owner, std::size_t index) noexcept;
+
+        template < typename T, typename V >
+        friend class detail::typed_instantiator;
+    private:
+        template < typename T >
+        using vector_ = std::vector<T, detail::resource_allocator<T>>;
+
+        template < typename T >
+        using family_map_ = detail::sparse_map<
+            family_id,
+            T,
+            detail::sparse_indexer<family_id>,
+            detail::default_sparse_index_t<family_id>,
+            detail::resource_allocator<T>>;
     private:
+        memory_resource* resource_{nullptr};
+
         entity_id last_entity_id_{0u};
-        std::vector<entity_id> free_entity_ids_;
+        entity_id free_entity_index_{0u};
+        std::size_t entity_count_{0u};
 
+        // alive slots hold their entity ids, dead slots hold
+        // the next free index (zero is the end) and the last version
         mutable detail::incremental_locker entity_ids_locker_;
-        detail::sparse_set<entity_id, detail::entity_id_indexer> entity_ids_;
+        detail::sparse_pages<
+            entity_id,
+            1024u,
+            detail::resource_allocator<entity_id>> entity_ids_;
 
-        using storage_uptr = std::unique_ptr<detail::component_storage_base>;
-        detail::sparse_map<family_id, storage_uptr> storages_;
+        // the storages of every entity, the bits are storage dense indices
+        detail::signature_table<
+            detail::resource_allocator<std::uint64_t>> signatures_;
+
+        // storages are never erased, so a slot is also the storage signature bit,
+        // a compacted storage leaves an empty slot for the same component type
+        using storage_uptr = detail::resource_uptr<detail::component_storage_base>;
+        vector_<storage_uptr> storages_;
+        vector_<std::pair<family_id, std::size_t>> storage_slots_;
+
+        using group_uptr = detail::resource_uptr<detail::component_group_base>;
+        vector_<group_uptr> groups_;
 
         mutable detail::incremental_locker features_locker_;
-        detail::sparse_map<family_id, feature> features_;
+        family_map_<feature> features_;
+
+        shrink_policy_info shrink_policy_;
+
+        growth_policy growth_policy_;
+        growth_observer* growth_observer_{nullptr};
+
+        detail::resource_uptr<detail::archetype_world> archetypes_;
     };
 }
 
@@ -1621,7 +5679,7 @@ namespace ecs_hpp
     class exists_any final {
     public:
         bool operator()(const const_entity& e) const {
-            return (... || e.exists_component<Ts>());
+            return e.owner().exists_any_components<Ts...>(e);
         }
     };
 
@@ -1629,7 +5687,7 @@ namespace ecs_hpp
     class exists_all final {
     public:
         bool operator()(const const_entity& e) const {
-            return (... && e.exists_component<Ts>());
+            return e.owner().exists_all_components<Ts...>(e);
         }
     };
 
@@ -1734,7 +5792,7 @@ namespace ecs_hpp
         }
 
         static bool match_entity(const const_entity& e) noexcept {
-            return (... && e.exists_component<Ts>());
+            return e.owner().exists_all_components<Ts...>(e);
         }
 
         template < typename F, typename... Opts >
@@ -1846,19 +5904,27 @@ namespace ecs_hpp
     }
 
     template < typename T, typename... Args >
-    T& entity::assign_component(Args&&... args) {
+    component_reference<T> entity::assign_component(Args&&... args) {
         return (*owner_).assign_component<T>(
             id_,
             std::forward<Args>(args)...);
     }
 
     template < typename T, typename... Args >
-    T& entity::ensure_component(Args&&... args) {
+    component_reference<T> entity::ensure_component(Args&&... args) {
         return (*owner_).ensure_component<T>(
             id_,
             std::forward<Args>(args)...);
     }
 
+    template < typename T, typename F, typename... Args >
+    component_reference<T> entity::update_component(F&& f, Args&&... args) {
+        return (*owner_).update_component<T>(
+            id_,
+            std::forward<F>(f),
+            std::forward<Args>(args)...);
+    }
+
     template < typename T >
     bool entity::remove_component() noexcept {
         return (*owner_).remove_component<T>(id_);
@@ -1874,42 +5940,42 @@ namespace ecs_hpp
     }
 
     template < typename T >
-    T& entity::get_component() {
+    component_reference<T> entity::get_component() {
         return (*owner_).get_component<T>(id_);
     }
 
     template < typename T >
-    const T& entity::get_component() const {
+    const_component_reference<T> entity::get_component() const {
         return std::as_const(*owner_).get_component<T>(id_);
     }
 
     template < typename T >
-    T* entity::find_component() noexcept {
+    component_pointer<T> entity::find_component() noexcept {
         return (*owner_).find_component<T>(id_);
     }
 
     template < typename T >
-    const T* entity::find_component() const noexcept {
+    const_component_pointer<T> entity::find_component() const noexcept {
         return std::as_const(*owner_).find_component<T>(id_);
     }
 
     template < typename... Ts >
-    std::tuple<Ts&...> entity::get_components() {
+    std::tuple<component_reference<Ts>...> entity::get_components() {
         return (*owner_).get_components<Ts...>(id_);
     }
 
     template < typename... Ts >
-    std::tuple<const Ts&...> entity::get_components() const {
+    std::tuple<const_component_reference<Ts>...> entity::get_components() const {
         return std::as_const(*owner_).get_components<Ts...>(id_);
     }
 
     template < typename... Ts >
-    std::tuple<Ts*...> entity::find_components() noexcept {
+    std::tuple<component_pointer<Ts>...> entity::find_components() noexcept {
         return (*owner_).find_components<Ts...>(id_);
     }
 
     template < typename... Ts >
-    std::tuple<const Ts*...> entity::find_components() const noexcept {
+    std::tuple<const_component_pointer<Ts>...> entity::find_components() const noexcept {
         return std::as_const(*owner_).find_components<Ts...>(id_);
     }
 
@@ -1978,22 +6044,22 @@ namespace ecs_hpp
     }
 
     template < typename T >
-    const T& const_entity::get_component() const {
+    const_component_reference<T> const_entity::get_component() const {
         return (*owner_).get_component<T>(id_);
     }
 
     template < typename T >
-    const T* const_entity::find_component() const noexcept {
+    const_component_pointer<T> const_entity::find_component() const noexcept {
         return (*owner_).find_component<T>(id_);
     }
 
     template < typename... Ts >
-    std::tuple<const Ts&...> const_entity::get_components() const {
+    std::tuple<const_component_reference<Ts>...> const_entity::get_components() const {
         return (*owner_).get_components<Ts...>(id_);
     }
 
     template < typename... Ts >
-    std::tuple<const Ts*...> const_entity::find_components() const noexcept {
+    std::tuple<const_component_pointer<Ts>...> const_entity::find_components() const noexcept {
         return (*owner_).find_components<Ts...>(id_);
     }
 
@@ -2059,58 +6125,66 @@ namespace ecs_hpp
 
     template < typename T >
     template < typename... Args >
-    T& component<T>::assign(Args&&... args) {
+    component_reference<T> component<T>::assign(Args&&... args) {
         return owner_.assign_component<T>(std::forward<Args>(args)...);
     }
 
     template < typename T >
     template < typename... Args >
-    T& component<T>::ensure(Args&&... args) {
+    component_reference<T> component<T>::ensure(Args&&... args) {
         return owner_.ensure_component<T>(std::forward<Args>(args)...);
     }
 
+    template < typename T >
+    template < typename F, typename... Args >
+    component_reference<T> component<T>::update(F&& f, Args&&... args) {
+        return owner_.update_component<T>(
+            std::forward<F>(f),
+            std::forward<Args>(args)...);
+    }
+
     template < typename T >
     bool component<T>::remove() noexcept {
         return owner_.remove_component<T>();
     }
 
     template < typename T >
-    T& component<T>::get() {
+    component_reference<T> component<T>::get() {
         return owner_.get_component<T>();
     }
 
     template < typename T >
-    const T& component<T>::get() const {
+    const_component_reference<T> component<T>::get() const {
         return std::as_const(owner_).template get_component<T>();
     }
 
     template < typename T >
-    T* component<T>::find() noexcept {
+    component_pointer<T> component<T>::find() noexcept {
         return owner_.find_component<T>();
     }
 
     template < typename T >
-    const T* component<T>::find() const noexcept {
+    const_component_pointer<T> component<T>::find() const noexcept {
         return std::as_const(owner_).template find_component<T>();
     }
 
     template < typename T >
-    T& component<T>::operator*() {
+    component_reference<T> component<T>::operator*() {
         return get();
     }
 
     template < typename T >
-    const T& component<T>::operator*() const {
+    const_component_reference<T> component<T>::operator*() const {
         return get();
     }
 
     template < typename T >
-    T* component<T>::operator->() noexcept {
+    component_pointer<T> component<T>::operator->() noexcept {
         return find();
     }
 
     template < typename T >
-    const T* component<T>::operator->() const noexcept {
+    const_component_pointer<T> component<T>::operator->() const noexcept {
         return find();
     }
 
@@ -2177,22 +6251,22 @@ namespace ecs_hpp
     }
 
     template < typename T >
-    const T& const_component<T>::get() const {
+    const_component_reference<T> const_component<T>::get() const {
         return std::as_const(owner_).template get_component<T>();
     }
 
     template < typename T >
-    const T* const_component<T>::find() const noexcept {
+    const_component_pointer<T> const_component<T>::find() const noexcept {
         return std::as_const(owner_).template find_component<T>();
     }
 
     template < typename T >
-    const T& const_component<T>::operator*() const {
+    const_component_reference<T> const_component<T>::operator*() const {
         return get();
     }
 
     template < typename T >
-    const T* const_component<T>::operator->() const noexcept {
+    const_component_pointer<T> const_component<T>::operator->() const noexcept {
         return find();
     }
 
@@ -2237,6 +6311,33 @@ namespace ecs_hpp
 {
     namespace detail
     {
+        template < typename T >
+        shared_applier<T>::shared_applier(const shared_handle<T>& value)
+        : value_(value) {}
+
+        template < typename T >
+        applier_uptr shared_applier<T>::clone(memory_resource* resource) const {
+            return allocate_unique<shared_applier>(resource, value_);
+        }
+
+        template < typename T >
+        instantiator_uptr shared_applier<T>::compile(registry& owner, memory_resource* resource) const {
+            return allocate_unique<typed_instantiator<T, shared_handle<T>>>(
+                resource, owner, shared_handle<T>(value_));
+        }
+
+        template < typename T >
+        void shared_applier<T>::apply_to_entity(entity& ent, bool override) const {
+            if ( override || !ent.exists_component<T>() ) {
+                ent.assign_component<T>(value_);
+            }
+        }
+
+        template < typename T >
+        void shared_applier<T>::apply_to_component(T& component) const {
+            component = value_.value();
+        }
+
         template < typename T, typename... Args >
         typed_applier_with_args<T, Args...>::typed_applier_with_args(std::tuple<Args...>&& args)
         : args_(std::move(args)) {}
@@ -2246,8 +6347,19 @@ namespace ecs_hpp
         : args_(args) {}
 
         template < typename T, typename... Args >
-        applier_uptr typed_applier_with_args<T, Args...>::clone() const {
-            return std::make_unique<typed_applier_with_args>(args_);
+        applier_uptr typed_applier_with_args<T, Args...>::clone(memory_resource* resource) const {
+            return allocate_unique<typed_applier_with_args>(resource, args_);
+        }
+
+        template < typename T, typename... Args >
+        instantiator_uptr typed_applier_with_args<T, Args...>::compile(
+            registry& owner,
+            memory_resource* resource) const
+        {
+            return std::apply([&owner, resource](const Args&... args){
+                return instantiator_uptr(allocate_unique<typed_instantiator<T>>(
+                    resource, owner, make_value<T>(args...)));
+            }, args_);
         }
 
         template < typename T, typename... Args >
@@ -2267,9 +6379,13 @@ namespace ecs_hpp
         }
     }
 
-    inline prototype::prototype(const prototype& other) {
+    inline prototype::prototype(memory_resource* resource)
+    : appliers_(detail::sparse_indexer<family_id>(), resource) {}
+
+    inline prototype::prototype(const prototype& other)
+    : prototype(other.resource()) {
         for ( const family_id family : other.appliers_ ) {
-            appliers_.insert(family, other.appliers_.get(family)->clone());
+            appliers_.insert(family, other.appliers_.get(family)->clone(resource()));
         }
     }
 
@@ -2305,6 +6421,10 @@ namespace ecs_hpp
         swap(appliers_, other.appliers_);
     }
 
+    inline memory_resource* prototype::resource() const noexcept {
+        return appliers_.get_allocator().resource();
+    }
+
     template < typename T >
     bool prototype::has_component() const noexcept {
         const auto family = detail::type_family<T>::id();
@@ -2313,13 +6433,22 @@ namespace ecs_hpp
 
     template < typename T, typename... Args >
     prototype& prototype::component(Args&&... args) & {
-        using applier_t = detail::typed_applier_with_args<
-            T,
-            std::decay_t<Args>...>;
-        auto applier = std::make_unique<applier_t>(
-            std::make_tuple(std::forward<Args>(args)...));
         const auto family = detail::type_family<T>::id();
-        appliers_.insert_or_assign(family, std::move(applier));
+        if constexpr ( detail::is_shared_component_v<T> ) {
+            // every entity made from the prototype shares this instance
+            auto applier = detail::allocate_unique<detail::shared_applier<T>>(
+                resource(),
+                detail::shared_handle<T>::make(resource(), std::forward<Args>(args)...));
+            appliers_.insert_or_assign(family, std::move(applier));
+        } else {
+            using applier_t = detail::typed_applier_with_args<
+                T,
+                std::decay_t<Args>...>;
+            auto applier = detail::allocate_unique<applier_t>(
+                resource(),
+                std::make_tuple(std::forward<Args>(args)...));
+            appliers_.insert_or_assign(family, std::move(applier));
+        }
         return *this;
     }
 
@@ -2334,7 +6463,7 @@ namespace ecs_hpp
             if ( override || !appliers_.has(family) ) {
                 appliers_.insert_or_assign(
                     family,
-                    other.appliers_.get(family)->clone());
+                    other.appliers_.get(family)->clone(resource()));
             }
         }
         return *this;
@@ -2369,6 +6498,54 @@ namespace ecs_hpp
     }
 }
 
+// -----------------------------------------------------------------------------
+//
+// compiled_prototype impl
+//
+// -----------------------------------------------------------------------------
+
+namespace ecs_hpp
+{
+    namespace detail
+    {
+        template < typename T, typename V >
+        typed_instantiator<T, V>::typed_instantiator(registry& owner, V&& value)
+        : slot_(owner.instantiation_slot_<T>())
+        , value_(std::move(value)) {}
+
+        template < typename T, typename V >
+        void typed_instantiator<T, V>::instantiate(
+            registry& owner,
+            const entity_id* first,
+            const entity_id* last) const
+        {
+            owner.instantiate_components_<T>(slot_, value_, first, last);
+        }
+    }
+
+    inline compiled_prototype::compiled_prototype(registry& owner, const prototype& proto)
+    : owner_(&owner)
+    , instantiators_(proto.resource()) {
+        instantiators_.reserve(proto.appliers_.size());
+        for ( const family_id family : proto.appliers_ ) {
+            instantiators_.push_back(
+                proto.appliers_.get(family)->compile(owner, proto.resource()));
+        }
+    }
+
+    inline registry& compiled_prototype::owner() const noexcept {
+        return *owner_;
+    }
+
+    inline bool compiled_prototype::empty() const noexcept {
+        return instantiators_.empty();
+    }
+
+    inline std::size_t compiled_prototype::component_count() const noexcept {
+        return instantiators_.size();
+    }
+}
+
 // -----------------------------------------------------------------------------
 //
 // feature impl
@@ -2377,6 +6554,9 @@ namespace ecs_hpp
 
 namespace ecs_hpp
 {
+    inline feature::feature(memory_resource* resource)
+    : systems_(resource) {}
+
     inline feature& feature::enable() & noexcept {
         disabled_ = false;
         return *this;
@@ -2408,7 +6588,10 @@ namespace ecs_hpp
     template < typename T, typename... Args >
     feature& feature::add_system(Args&&... args) & {
         assert(!systems_locker_.is_locked());
-        systems_.push_back(std::make_unique<T>(std::forward<Args>(args)...));
+        systems_.reserve(systems_.size() + 1u);
+        systems_.push_back(detail::allocate_unique<T>(
+            systems_.get_allocator().resource(),
+            std::forward<Args>(args)...));
         return *this;
     }
 
@@ -2540,6 +6723,72 @@ namespace ecs_hpp
     // registry
     //
 
+    inline registry::registry()
+    : registry(new_delete_resource()) {}
+
+    inline registry::registry(memory_resource* resource)
+    : resource_(resource)
+    , entity_ids_(resource)
+    , signatures_(resource)
+    , storages_(resource)
+    , storage_slots_(resource)
+    , groups_(resource)
+    , features_(detail::sparse_indexer<family_id>(), resource) {
+        assert(resource);
+    }
+
+    inline registry::registry(registry_backend backend, memory_resource* resource)
+    : registry(resource) {
+        if ( backend == registry_backend::archetype ) {
+            archetypes_ = detail::allocate_unique<detail::archetype_world>(resource_, resource_);
+        }
+    }
+
+    // the fork is constructed in place, the storages refer to their registry
+    inline registry::registry(const registry& other, fork_tag_)
+    : resource_(other.resource_)
+    , last_entity_id_(other.last_entity_id_)
+    , free_entity_index_(other.free_entity_index_)
+    , entity_count_(other.entity_count_)
+    , entity_ids_(other.entity_ids_)
+    , signatures_(other.signatures_)
+    , storages_(resource_)
+    , storage_slots_(other.storage_slots_)
+    , groups_(resource_)
+    , features_(detail::sparse_indexer<family_id>(), resource_)
+    , shrink_policy_(other.shrink_policy_)
+    , growth_policy_(other.growth_policy_)
+    , growth_observer_(other.growth_observer_) {
+        storages_.reserve(other.storages_.size());
+        for ( const storage_uptr& storage : other.storages_ ) {
+            storages_.push_back(storage
+                ? storage->fork(*this, resource_)
+                : storage_uptr());
+        }
+        groups_.reserve(other.groups_.size());
+        for ( const group_uptr& group : other.groups_ ) {
+            groups_.push_back(group->fork(storages_.data(), resource_));
+        }
+        if ( other.archetypes_ ) {
+            archetypes_ = detail::allocate_unique<detail::archetype_world>(
+                resource_, *other.archetypes_);
+        }
+    }
+
+    inline registry registry::fork() const {
+        return registry(*this, fork_tag_{});
+    }
+
+    inline registry_backend registry::backend() const noexcept {
+        return archetypes_
+            ? registry_backend::archetype
+            : registry_backend::sparse;
+    }
+
+    inline memory_resource* registry::resource() const noexcept {
+        return resource_;
+    }
+
     inline entity registry::wrap_entity(const const_uentity& ent) noexcept {
         return {*this, ent.id()};
     }
@@ -2560,28 +6809,109 @@ namespace ecs_hpp
 
     inline entity registry::create_entity() {
         assert(!entity_ids_locker_.is_locked());
-        if ( !free_entity_ids_.empty() ) {
-            const auto free_ent_id = free_entity_ids_.back();
-            const auto new_ent_id = detail::upgrade_entity_id(free_ent_id);
-            entity_ids_.insert(new_ent_id);
-            free_entity_ids_.pop_back();
-            return wrap_entity(new_ent_id);
-
+        if ( free_entity_index_ ) {
+            return wrap_entity(recycle_entity_id_());
         }
         if ( last_entity_id_ >= detail::entity_id_index_mask ) {
             throw std::logic_error("ecs_hpp::registry (entity index overlow)");
         }
-        if ( free_entity_ids_.capacity() <= entity_ids_.size() ) {
-            // ensure free entity ids capacity for safe (noexcept) entity destroying
-            free_entity_ids_.reserve(detail::next_capacity_size(
-                free_entity_ids_.capacity(),
-                entity_ids_.size() + 1,
-                free_entity_ids_.max_size()));
-        }
-        entity_ids_.insert(last_entity_id_ + 1);
+        entity_ids_.assure(last_entity_id_ + 1) = last_entity_id_ + 1;
+        ++entity_count_;
         return wrap_entity(++last_entity_id_);
     }
 
+    template < typename OutputIt >
+    OutputIt registry::create_entities(std::size_t count, OutputIt out) {
+        assert(!entity_ids_locker_.is_locked());
+        const std::size_t free_count = static_cast<std::size_t>(last_entity_id_) - entity_count_;
+        const std::size_t recycled_count = std::min(count, free_count);
+        const std::size_t minted_count = count - recycled_count;
+        if ( minted_count > static_cast<std::size_t>(detail::entity_id_index_mask - last_entity_id_) ) {
+            throw std::logic_error("ecs_hpp::registry (entity index overlow)");
+        }
+
+        // the slot pages are allocated first, nothing but `out` can fail below
+        constexpr std::size_t page_size = decltype(entity_ids_)::page_size;
+        const std::size_t first_index = static_cast<std::size_t>(last_entity_id_) + 1u;
+        const std::size_t end_index = first_index + minted_count;
+        for ( std::size_t i = first_index; i < end_index; i = (i / page_size + 1u) * page_size ) {
+            entity_ids_.assure(i);
+        }
+
+        for ( std::size_t i = 0; i < recycled_count; ++i ) {
+            const entity_id id = recycle_entity_id_();
+            try {
+                *out = wrap_entity(id);
+                ++out;
+            } catch (...) {
+                destroy_entity(wrap_entity(id));
+                throw;
+            }
+        }
+
+        // a new slot holds its own index with the zero version
+        for ( std::size_t i = first_index; i < end_index; ) {
+            const std::size_t page_end = std::min(end_index, (i / page_size + 1u) * page_size);
+            entity_id* slots = &entity_ids_[i];
+            std::iota(slots, slots + (page_end - i), static_cast<entity_id>(i));
+            i = page_end;
+        }
+        last_entity_id_ = static_cast<entity_id>(end_index - 1u);
+        entity_count_ += minted_count;
+
+        for ( std::size_t i = first_index; i < end_index; ++i ) {
+            try {
+                *out = wrap_entity(static_cast<entity_id>(i));
+                ++out;
+            } catch (...) {
+                for ( std::size_t j = i; j < end_index; ++j ) {
+                    destroy_entity(wrap_entity(static_cast<entity_id>(j)));
+                }
+                throw;
+            }
+        }
+        return out;
+    }
+
+    inline std::vector<entity> registry::create_entities(std::size_t count) {
+        std::vector<entity> entities;
+        entities.reserve(count);
+        create_entities(count, std::back_inserter(entities));
+        return entities;
+    }
+
+    inline entity registry::create_entity(const compiled_prototype& proto) {
+        assert(proto.owner_ == this);
+        entity ent = create_entity();
+        const entity_id id = ent.id();
+        try {
+            for ( const auto& instantiator : proto.instantiators_ ) {
+                instantiator->instantiate(*this, &id, &id + 1);
+            }
+        } catch (...) {
+            destroy_entity(ent);
+            throw;
+        }
+        return ent;
+    }
+
+    template < typename OutputIt >
+    OutputIt registry::create_entities(const compiled_prototype& proto, std::size_t count, OutputIt out) {
+        assert(proto.owner_ == this);
+        return create_entities_(count, out, [this, &proto](const entity_id* first, const entity_id* last){
+            for ( const auto& instantiator : proto.instantiators_ ) {
+                instantiator->instantiate(*this, first, last);
+            }
+        });
+    }
+
+    inline std::vector<entity> registry::create_entities(const compiled_prototype& proto, std::size_t count) {
+        std::vector<entity> entities;
+        entities.reserve(count);
+        create_entities(proto, count, std::back_inserter(entities));
+        return entities;
+    }
+
     inline entity registry::create_entity(const prototype& proto) {
         auto ent = create_entity();
         try {
@@ -2590,112 +6920,381 @@ namespace ecs_hpp
             destroy_entity(ent);
             throw;
         }
-        return ent;
+        return ent;
+    }
+
+    template < typename OutputIt >
+    OutputIt registry::clone_entities(const const_uentity& proto, std::size_t count, OutputIt out) {
+        assert(valid_entity(proto));
+        return create_entities_(count, out, [this, &proto](const entity_id* first, const entity_id* last){
+            if ( archetypes_ ) {
+                for ( const entity_id* iter = first; iter != last; ++iter ) {
+                    archetypes_->clone(proto, *iter);
+                }
+                return;
+            }
+            // the signature bits are set first, so a failed clone
+            // leaves nothing behind when the entities are destroyed
+            signatures_.for_each(detail::entity_id_index(proto), [this, &proto, first, last](std::size_t bit){
+                for ( const entity_id* iter = first; iter != last; ++iter ) {
+                    assure_signature_(detail::entity_id_index(*iter), bit);
+                    signatures_.set(detail::entity_id_index(*iter), bit);
+                }
+                storages_[bit]->clone_each(proto, first, last);
+            });
+        });
+    }
+
+    inline std::vector<entity> registry::clone_entities(const const_uentity& proto, std::size_t count) {
+        std::vector<entity> entities;
+        entities.reserve(count);
+        clone_entities(proto, count, std::back_inserter(entities));
+        return entities;
+    }
+
+    template < typename OutputIt, typename F >
+    OutputIt registry::create_entities_(std::size_t count, OutputIt out, F&& fill) {
+        vector_<entity> entities(resource_);
+        entities.reserve(count);
+        create_entities(count, std::back_inserter(entities));
+        try {
+            vector_<entity_id> ids(resource_);
+            ids.reserve(count);
+            for ( const entity& ent : entities ) {
+                ids.push_back(ent.id());
+            }
+            fill(ids.data(), ids.data() + ids.size());
+        } catch (...) {
+            destroy_entities(entities.begin(), entities.end());
+            throw;
+        }
+        for ( auto iter = entities.begin(); iter != entities.end(); ++iter ) {
+            try {
+                *out = *iter;
+                ++out;
+            } catch (...) {
+                destroy_entities(iter, entities.end());
+                throw;
+            }
+        }
+        return out;
+    }
+
+    inline entity registry::create_entity(const const_uentity& proto) {
+        assert(valid_entity(proto));
+        entity ent = create_entity();
+        try {
+            if ( archetypes_ ) {
+                archetypes_->clone(proto, ent.id());
+            }
+            const std::size_t row = detail::entity_id_index(ent.id());
+            signatures_.for_each(detail::entity_id_index(proto), [this, &proto, &ent, row](std::size_t bit){
+                assure_signature_(row, bit);
+                storages_[bit]->clone(proto, ent.id());
+                signatures_.set(row, bit);
+            });
+        } catch (...) {
+            destroy_entity(ent);
+            throw;
+        }
+        return ent;
+    }
+
+    inline void registry::destroy_entity(const uentity& ent) noexcept {
+        assert(!entity_ids_locker_.is_locked());
+        assert(valid_entity(ent));
+        remove_all_components(ent);
+        release_entity_id_(ent);
+    }
+
+    template < typename ForwardIt >
+    void registry::destroy_entities(ForwardIt first, ForwardIt last) noexcept {
+        assert(!entity_ids_locker_.is_locked());
+        vector_<entity_id> ids(resource_);
+        try {
+            ids.reserve(static_cast<std::size_t>(std::distance(first, last)));
+            for ( ForwardIt iter = first; iter != last; ++iter ) {
+                const uentity ent = *iter;
+                assert(valid_entity(ent));
+                ids.push_back(ent);
+            }
+        } catch (...) {
+            // without the id list the entities are destroyed one by one
+            for ( ; first != last; ++first ) {
+                destroy_entity(*first);
+            }
+            return;
+        }
+        destroy_entities_(ids.data(), ids.data() + ids.size());
+    }
+
+    inline bool registry::valid_entity(const const_uentity& ent) const noexcept {
+        assert(ent.check_owner(this));
+        const entity_id* slot = entity_ids_.find(detail::entity_id_index(ent));
+        return detail::entity_id_index(ent) && slot && *slot == ent;
+    }
+
+    template < typename T, typename... Args >
+    component_reference<T> registry::assign_component(const uentity& ent, Args&&... args) {
+        assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            if constexpr ( detail::is_shared_handle_args_v<T, Args...> ) {
+                // archetype tables keep a copy of a shared component per entity
+                return archetypes_->assign<T>(ent, args.value()...);
+            } else {
+                return archetypes_->assign<T>(ent, std::forward<Args>(args)...);
+            }
+        }
+        detail::component_storage<T>& storage = get_or_create_storage_<T>();
+        assure_signature_(detail::entity_id_index(ent), storage.signature_bit());
+        component_reference<T> component = storage.assign(
+            ent,
+            std::forward<Args>(args)...);
+        signatures_.set(detail::entity_id_index(ent), storage.signature_bit());
+        return component;
+    }
+
+    template < typename T, typename IdIt, typename ValueIt >
+    void registry::assign_components(IdIt ids_first, IdIt ids_last, ValueIt values_first) {
+        using id_reference = typename std::iterator_traits<IdIt>::reference;
+        if constexpr ( std::is_convertible_v<id_reference, entity_id> ) {
+            assign_components_<T>(ids_first, ids_last, values_first);
+        } else {
+            // storages index by ids, so the entities are converted once
+            vector_<entity_id> ids(resource_);
+            ids.reserve(static_cast<std::size_t>(std::distance(ids_first, ids_last)));
+            for ( ; ids_first != ids_last; ++ids_first ) {
+                ids.push_back(uentity(*ids_first));
+            }
+            assign_components_<T>(ids.cbegin(), ids.cend(), values_first);
+        }
     }
 
-    inline entity registry::create_entity(const const_uentity& proto) {
-        assert(valid_entity(proto));
-        entity ent = create_entity();
-        try {
-            for ( const auto family : storages_ ) {
-                storages_.get(family)->clone(proto, ent.id());
+    template < typename T, typename IdIt, typename ValueIt >
+    void registry::assign_components_(IdIt ids_first, IdIt ids_last, ValueIt values_first) {
+        if ( archetypes_ ) {
+            for ( ; ids_first != ids_last; ++ids_first, ++values_first ) {
+                assign_component<T>(*ids_first, *values_first);
             }
+            return;
+        }
+        assign_storage_components_(get_or_create_storage_<T>(), ids_first, ids_last, values_first);
+    }
+
+    template < typename T, typename IdIt, typename ValueIt >
+    void registry::assign_storage_components_(
+        detail::component_storage<T>& storage,
+        IdIt ids_first,
+        IdIt ids_last,
+        ValueIt values_first)
+    {
+        const std::size_t bit = storage.signature_bit();
+        for ( IdIt iter = ids_first; iter != ids_last; ++iter ) {
+            const uentity ent = *iter;
+            assert(valid_entity(ent));
+            assure_signature_(detail::entity_id_index(ent), bit);
+        }
+        try {
+            storage.assign_range(ids_first, ids_last, values_first);
         } catch (...) {
-            destroy_entity(ent);
+            // the rows of the ids assigned so far get the signature bit below
+            for ( IdIt iter = ids_first; iter != ids_last; ++iter ) {
+                const uentity ent = *iter;
+                if ( storage.exists(ent) ) {
+                    signatures_.set(detail::entity_id_index(ent), bit);
+                }
+            }
             throw;
         }
-        return ent;
+        for ( IdIt iter = ids_first; iter != ids_last; ++iter ) {
+            const uentity ent = *iter;
+            signatures_.set(detail::entity_id_index(ent), bit);
+        }
     }
 
-    inline void registry::destroy_entity(const uentity& ent) noexcept {
-        assert(!entity_ids_locker_.is_locked());
+    template < typename T, typename... Args >
+    component_reference<T> registry::ensure_component(const uentity& ent, Args&&... args) {
         assert(valid_entity(ent));
-        remove_all_components(ent);
-        if ( entity_ids_.unordered_erase(ent) ) {
-            assert(free_entity_ids_.size() < free_entity_ids_.capacity());
-            free_entity_ids_.push_back(ent);
+        if ( archetypes_ ) {
+            return archetypes_->ensure<T>(ent, std::forward<Args>(args)...);
         }
+        detail::component_storage<T>& storage = get_or_create_storage_<T>();
+        assure_signature_(detail::entity_id_index(ent), storage.signature_bit());
+        component_reference<T> component = storage.ensure(
+            ent,
+            std::forward<Args>(args)...);
+        signatures_.set(detail::entity_id_index(ent), storage.signature_bit());
+        return component;
     }
 
-    inline bool registry::valid_entity(const const_uentity& ent) const noexcept {
-        assert(ent.check_owner(this));
-        return entity_ids_.has(ent);
+    template < typename T, typename F, typename... Args >
+    component_reference<T> registry::update_component(const uentity& ent, F&& f, Args&&... args) {
+        component_reference<T> component = ensure_component<T>(
+            ent,
+            std::forward<Args>(args)...);
+        f(component);
+        return component;
     }
 
-    template < typename T, typename... Args >
-    T& registry::assign_component(const uentity& ent, Args&&... args) {
+    template < typename T >
+    component_reference<T> registry::share_component(const uentity& to, const const_uentity& from) {
+        assert(valid_entity(to));
+        assert(valid_entity(from));
+        if constexpr ( detail::is_shared_component_v<T> ) {
+            if ( !archetypes_ ) {
+                detail::component_storage<T>* storage = find_storage_<T>();
+                if ( !storage || !storage->exists(from) ) {
+                    throw std::logic_error("ecs_hpp::registry (component not found)");
+                }
+                assure_signature_(detail::entity_id_index(to), storage->signature_bit());
+                storage->clone(from, to);
+                signatures_.set(detail::entity_id_index(to), storage->signature_bit());
+                return *storage->find(to);
+            }
+        }
+        return assign_component<T>(to, T(get_component<T>(from)));
+    }
+
+    template < typename T >
+    T& registry::detach_component(const uentity& ent) {
+        static_assert(
+            detail::is_shared_component_v<T>,
+            "ecs_hpp (only shared components can be detached)");
         assert(valid_entity(ent));
-        return get_or_create_storage_<T>().assign(
-            ent,
-            std::forward<Args>(args)...);
+        T* component = nullptr;
+        if ( archetypes_ ) {
+            component = archetypes_->find_assignable<T>(ent);
+        } else if ( detail::component_storage<T>* storage = find_storage_<T>() ) {
+            component = storage->detach(ent);
+        }
+        if ( !component ) {
+            throw std::logic_error("ecs_hpp::registry (component not found)");
+        }
+        return *component;
     }
 
-    template < typename T, typename... Args >
-    T& registry::ensure_component(const uentity& ent, Args&&... args) {
+    template < typename T >
+    std::size_t registry::component_use_count(const const_uentity& ent) const noexcept {
         assert(valid_entity(ent));
-        return get_or_create_storage_<T>().ensure(
-            ent,
-            std::forward<Args>(args)...);
+        if constexpr ( detail::is_shared_component_v<T> ) {
+            if ( !archetypes_ ) {
+                const detail::component_storage<T>* storage = find_storage_<T>();
+                return storage ? storage->use_count(ent) : 0u;
+            }
+        }
+        return exists_component<T>(ent) ? 1u : 0u;
     }
 
     template < typename T >
     bool registry::remove_component(const uentity& ent) noexcept {
         assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            // moving to another archetype may allocate, a failure terminates
+            return archetypes_->remove<T>(ent);
+        }
         detail::component_storage<T>* storage = find_storage_<T>();
-        return storage
-            ? storage->remove(ent)
-            : false;
+        if ( !storage || !storage->remove(ent) ) {
+            return false;
+        }
+        signatures_.reset(detail::entity_id_index(ent), storage->signature_bit());
+        shrink_if_sparse_(*storage);
+        return true;
     }
 
     template < typename T >
     bool registry::exists_component(const const_uentity& ent) const noexcept {
         assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            return archetypes_->exists<T>(ent);
+        }
         const detail::component_storage<T>* storage = find_storage_<T>();
         return storage
             ? storage->exists(ent)
             : false;
     }
 
+    template < typename... Ts >
+    bool registry::exists_all_components(const const_uentity& ent) const noexcept {
+        assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            return (... && archetypes_->exists<Ts>(ent));
+        }
+        [[maybe_unused]] const std::size_t row = detail::entity_id_index(ent);
+        return (... && [this, row](const detail::component_storage_base* storage){
+            return storage && signatures_.test(row, storage->signature_bit());
+        }(find_storage_<Ts>()));
+    }
+
+    template < typename... Ts >
+    bool registry::exists_any_components(const const_uentity& ent) const noexcept {
+        assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            return (... || archetypes_->exists<Ts>(ent));
+        }
+        [[maybe_unused]] const std::size_t row = detail::entity_id_index(ent);
+        return (... || [this, row](const detail::component_storage_base* storage){
+            return storage && signatures_.test(row, storage->signature_bit());
+        }(find_storage_<Ts>()));
+    }
+
     inline std::size_t registry::remove_all_components(const uentity& ent) noexcept {
         assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            return archetypes_->remove_all(ent);
+        }
         std::size_t removed_count = 0u;
-        for ( const auto family : storages_ ) {
-            if ( storages_.get(family)->remove(ent) ) {
+        const std::size_t row = detail::entity_id_index(ent);
+        signatures_.for_each(row, [this, &ent, &removed_count](std::size_t bit){
+            if ( storages_[bit]->remove(ent) ) {
+                shrink_if_sparse_(*storages_[bit]);
                 ++removed_count;
             }
-        }
+        });
+        signatures_.clear(row);
         return removed_count;
     }
 
     template < typename T >
     std::size_t registry::remove_all_components() noexcept {
+        if ( archetypes_ ) {
+            return archetypes_->remove_all<T>();
+        }
         detail::component_storage<T>* storage = find_storage_<T>();
-        return storage
-            ? storage->remove_all()
-            : 0u;
+        if ( !storage ) {
+            return 0u;
+        }
+        storage->for_each_component([this, storage](entity_id id, const auto&){
+            signatures_.reset(detail::entity_id_index(id), storage->signature_bit());
+        });
+        const std::size_t removed_count = storage->remove_all();
+        shrink_if_sparse_(*storage);
+        return removed_count;
     }
 
     template < typename T >
-    T& registry::get_component(const uentity& ent) {
+    component_reference<T> registry::get_component(const uentity& ent) {
         assert(valid_entity(ent));
-        if ( T* component = find_component<T>(ent) ) {
+        if ( component_pointer<T> component = find_component<T>(ent) ) {
             return *component;
         }
         throw std::logic_error("ecs_hpp::registry (component not found)");
     }
 
     template < typename T >
-    const T& registry::get_component(const const_uentity& ent) const {
+    const_component_reference<T> registry::get_component(const const_uentity& ent) const {
         assert(valid_entity(ent));
-        if ( const T* component = find_component<T>(ent) ) {
+        if ( const_component_pointer<T> component = find_component<T>(ent) ) {
             return *component;
         }
         throw std::logic_error("ecs_hpp::registry (component not found)");
     }
 
     template < typename T >
-    T* registry::find_component(const uentity& ent) noexcept {
+    component_pointer<T> registry::find_component(const uentity& ent) noexcept {
         assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            return archetypes_->find<T>(ent);
+        }
         detail::component_storage<T>* storage = find_storage_<T>();
         return storage
             ? storage->find(ent)
@@ -2703,8 +7302,11 @@ namespace ecs_hpp
     }
 
     template < typename T >
-    const T* registry::find_component(const const_uentity& ent) const noexcept {
+    const_component_pointer<T> registry::find_component(const const_uentity& ent) const noexcept {
         assert(valid_entity(ent));
+        if ( archetypes_ ) {
+            return std::as_const(*archetypes_).find<T>(ent);
+        }
         const detail::component_storage<T>* storage = find_storage_<T>();
         return storage
             ? storage->find(ent)
@@ -2712,28 +7314,28 @@ namespace ecs_hpp
     }
 
     template < typename... Ts >
-    std::tuple<Ts&...> registry::get_components(const uentity& ent) {
+    std::tuple<component_reference<Ts>...> registry::get_components(const uentity& ent) {
         (void)ent;
         assert(valid_entity(ent));
-        return std::make_tuple(std::ref(get_component<Ts>(ent))...);
+        return std::tuple<component_reference<Ts>...>(get_component<Ts>(ent)...);
     }
 
     template < typename... Ts >
-    std::tuple<const Ts&...> registry::get_components(const const_uentity& ent) const {
+    std::tuple<const_component_reference<Ts>...> registry::get_components(const const_uentity& ent) const {
         (void)ent;
         assert(valid_entity(ent));
-        return std::make_tuple(std::cref(get_component<Ts>(ent))...);
+        return std::tuple<const_component_reference<Ts>...>(get_component<Ts>(ent)...);
     }
 
     template < typename... Ts >
-    std::tuple<Ts*...> registry::find_components(const uentity& ent) noexcept {
+    std::tuple<component_pointer<Ts>...> registry::find_components(const uentity& ent) noexcept {
         (void)ent;
         assert(valid_entity(ent));
         return std::make_tuple(find_component<Ts>(ent)...);
     }
 
     template < typename... Ts >
-    std::tuple<const Ts*...> registry::find_components(const const_uentity& ent) const noexcept {
+    std::tuple<const_component_pointer<Ts>...> registry::find_components(const const_uentity& ent) const noexcept {
         (void)ent;
         assert(valid_entity(ent));
         return std::make_tuple(find_component<Ts>(ent)...);
@@ -2741,6 +7343,9 @@ namespace ecs_hpp
 
     template < typename T >
     std::size_t registry::component_count() const noexcept {
+        if ( archetypes_ ) {
+            return archetypes_->count<T>();
+        }
         const detail::component_storage<T>* storage = find_storage_<T>();
         return storage
             ? storage->count()
@@ -2748,24 +7353,25 @@ namespace ecs_hpp
     }
 
     inline std::size_t registry::entity_count() const noexcept {
-        return entity_ids_.size();
+        return entity_count_;
     }
 
     inline std::size_t registry::entity_component_count(const const_uentity& ent) const noexcept {
         assert(valid_entity(ent));
-        std::size_t component_count = 0u;
-        for ( const auto family : storages_ ) {
-            if ( storages_.get(family)->has(ent) ) {
-                ++component_count;
-            }
+        if ( archetypes_ ) {
+            return archetypes_->component_count(ent);
         }
-        return component_count;
+        return signatures_.count(detail::entity_id_index(ent));
     }
 
     template < typename F, typename... Opts >
     void registry::for_each_entity(F&& f, Opts&&... opts) {
         detail::incremental_lock_guard lock(entity_ids_locker_);
-        for ( const auto e : entity_ids_ ) {
+        for ( entity_id i = 1u; i <= last_entity_id_; ++i ) {
+            const entity_id e = entity_ids_[i];
+            if ( detail::entity_id_index(e) != i ) {
+                continue;
+            }
             if ( uentity ent{*this, e}; (... && opts(ent)) ) {
                 f(ent);
             }
@@ -2775,7 +7381,11 @@ namespace ecs_hpp
     template < typename F, typename... Opts >
     void registry::for_each_entity(F&& f, Opts&&... opts) const {
         detail::incremental_lock_guard lock(entity_ids_locker_);
-        for ( const auto e : entity_ids_ ) {
+        for ( entity_id i = 1u; i <= last_entity_id_; ++i ) {
+            const entity_id e = entity_ids_[i];
+            if ( detail::entity_id_index(e) != i ) {
+                continue;
+            }
             if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
                 f(ent);
             }
@@ -2784,8 +7394,16 @@ namespace ecs_hpp
 
     template < typename T, typename F, typename... Opts >
     void registry::for_each_component(F&& f, Opts&&... opts) {
+        if ( archetypes_ ) {
+            archetypes_->for_each<T>([this, &f, &opts...](const entity_id e, component_reference<T> t){
+                if ( uentity ent{*this, e}; (... && opts(ent)) ) {
+                    f(ent, t);
+                }
+            });
+            return;
+        }
         if ( detail::component_storage<T>* storage = find_storage_<T>() ) {
-            storage->for_each_component([this, &f, &opts...](const entity_id e, T& t){
+            storage->for_each_component([this, &f, &opts...](const entity_id e, component_reference<T> t){
                 if ( uentity ent{*this, e}; (... && opts(ent)) ) {
                     f(ent, t);
                 }
@@ -2795,8 +7413,16 @@ namespace ecs_hpp
 
     template < typename T, typename F, typename... Opts >
     void registry::for_each_component(F&& f, Opts&&... opts) const {
+        if ( archetypes_ ) {
+            std::as_const(*archetypes_).for_each<T>([this, &f, &opts...](const entity_id e, const_component_reference<T> t){
+                if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
+                    f(ent, t);
+                }
+            });
+            return;
+        }
         if ( const detail::component_storage<T>* storage = find_storage_<T>() ) {
-            storage->for_each_component([this, &f, &opts...](const entity_id e, const T& t){
+            storage->for_each_component([this, &f, &opts...](const entity_id e, const_component_reference<T> t){
                 if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
                     f(ent, t);
                 }
@@ -2820,14 +7446,75 @@ namespace ecs_hpp
             std::forward<Opts>(opts)...);
     }
 
+    template < typename... Ts >
+    void registry::group() {
+        if ( archetypes_ ) {
+            // archetype tables keep grouped components together already
+            return;
+        }
+        const auto ss = std::make_tuple(&get_or_create_storage_<Ts>()...);
+        const detail::component_group_base* g = std::get<0>(ss)->group();
+        const std::size_t grouped_count = std::apply([g](const auto*... storages){
+            return (... + std::size_t(storages->group() && storages->group() == g));
+        }, ss);
+        if ( g && grouped_count == sizeof...(Ts) && g->type_count() == sizeof...(Ts) ) {
+            return;
+        }
+        const bool any_grouped = std::apply([](const auto*... storages){
+            return (... || storages->group());
+        }, ss);
+        if ( any_grouped ) {
+            throw std::logic_error("ecs_hpp::registry (component already grouped)");
+        }
+        groups_.reserve(groups_.size() + 1u);
+        groups_.push_back(std::apply([this](auto*... storages){
+            return detail::allocate_unique<detail::component_group<Ts...>>(resource_, *storages...);
+        }, ss));
+    }
+
+    template < typename T, typename Compare >
+    void registry::sort_components(Compare&& compare) {
+        if ( detail::component_storage<T>* storage = find_sortable_storage_<T>() ) {
+            const detail::component_storage<T>& cstorage = *storage;
+            storage->sort([&cstorage, &compare](std::size_t l, std::size_t r){
+                return compare(cstorage.component_at(l), cstorage.component_at(r));
+            });
+        }
+    }
+
+    template < typename T, typename Compare >
+    void registry::sort_components_by_id(Compare&& compare) {
+        if ( detail::component_storage<T>* storage = find_sortable_storage_<T>() ) {
+            storage->sort([storage, &compare](std::size_t l, std::size_t r){
+                return compare(storage->id_at(l), storage->id_at(r));
+            });
+        }
+    }
+
+    template < typename T, typename U >
+    void registry::sort_components_as() {
+        detail::component_storage<T>* storage = find_sortable_storage_<T>();
+        const detail::component_storage<U>* other = find_storage_<U>();
+        if ( !storage || !other ) {
+            return;
+        }
+        assert(!storage->locker().is_locked());
+        std::size_t dense_index = 0u;
+        other->for_each_component([storage, &dense_index](const entity_id e, const auto&){
+            if ( const auto p = storage->find_dense_index(e); p.second ) {
+                storage->swap_dense(p.first, dense_index++);
+            }
+        });
+    }
+
     template < typename Tag, typename... Args >
     feature& registry::assign_feature(Args&&... args) {
         const auto feature_id = detail::type_family<Tag>::id();
         if ( feature* f = features_.find(feature_id) ) {
-            return *f = feature{std::forward<Args>(args)...};
+            return *f = make_feature_(std::forward<Args>(args)...);
         }
         assert(!features_locker_.is_locked());
-        return *features_.insert(feature_id, feature{std::forward<Args>(args)...}).first;
+        return *features_.insert(feature_id, make_feature_(std::forward<Args>(args)...)).first;
     }
 
     template < typename Tag, typename... Args >
@@ -2837,7 +7524,7 @@ namespace ecs_hpp
             return *f;
         }
         assert(!features_locker_.is_locked());
-        return *features_.insert(feature_id, feature{std::forward<Args>(args)...}).first;
+        return *features_.insert(feature_id, make_feature_(std::forward<Args>(args)...)).first;
     }
 
     template < typename Tag >
@@ -2877,40 +7564,137 @@ namespace ecs_hpp
 
     inline registry::memory_usage_info registry::memory_usage() const noexcept {
         memory_usage_info info;
-        info.entities += free_entity_ids_.capacity() * sizeof(free_entity_ids_[0]);
         info.entities += entity_ids_.memory_usage();
-        for ( const auto family : storages_ ) {
-            info.components += storages_.get(family)->memory_usage();
+        info.entities += signatures_.memory_usage();
+        if ( archetypes_ ) {
+            info.components += archetypes_->memory_usage();
+        }
+        for ( const storage_uptr& storage : storages_ ) {
+            info.components += storage ? storage->memory_usage() : 0u;
         }
         return info;
     }
 
     template < typename T >
     std::size_t registry::component_memory_usage() const noexcept {
+        if ( archetypes_ ) {
+            return archetypes_->memory_usage<T>();
+        }
         const detail::component_storage<T>* storage = find_storage_<T>();
         return storage
             ? storage->memory_usage()
             : 0u;
     }
 
+    inline void registry::shrink_to_fit() {
+        if ( archetypes_ ) {
+            archetypes_->shrink_to_fit();
+        }
+        for ( const storage_uptr& storage : storages_ ) {
+            if ( storage ) {
+                storage->shrink_to_fit();
+            }
+        }
+        signatures_.shrink_to_fit();
+    }
+
+    template < typename T >
+    void registry::shrink_to_fit() {
+        if ( archetypes_ ) {
+            // the columns of a type are spread over many archetypes
+            archetypes_->shrink_to_fit();
+            return;
+        }
+        if ( detail::component_storage<T>* storage = find_storage_<T>() ) {
+            storage->shrink_to_fit();
+        }
+    }
+
+    inline std::size_t registry::compact() noexcept {
+        std::size_t freed_count = 0u;
+        for ( storage_uptr& storage : storages_ ) {
+            // grouped storages and custom growth policies are kept
+            if ( storage
+                && !storage->count()
+                && !storage->group()
+                && !storage->custom_growth()
+                && !storage->locker().is_locked()
+                && !storage->join_locker().is_locked() )
+            {
+                storage.reset();
+                ++freed_count;
+            }
+        }
+        return freed_count;
+    }
+
+    inline void registry::set_growth_policy(const growth_policy& policy) noexcept {
+        growth_policy_ = policy;
+        if ( archetypes_ ) {
+            archetypes_->set_growth(growth_policy_, growth_observer_);
+        }
+        for ( const storage_uptr& storage : storages_ ) {
+            if ( storage ) {
+                storage->set_growth_policy(growth_policy_, false);
+            }
+        }
+    }
+
+    template < typename T >
+    void registry::set_growth_policy(const growth_policy& policy) {
+        if ( !archetypes_ ) {
+            get_or_create_storage_<T>().set_growth_policy(policy, true);
+        }
+    }
+
+    inline void registry::set_growth_observer(growth_observer* observer) noexcept {
+        growth_observer_ = observer;
+        if ( archetypes_ ) {
+            archetypes_->set_growth(growth_policy_, growth_observer_);
+        }
+        for ( const storage_uptr& storage : storages_ ) {
+            if ( storage ) {
+                storage->set_growth_observer(growth_observer_);
+            }
+        }
+    }
+
+    inline void registry::set_shrink_policy(const shrink_policy_info& policy) noexcept {
+        shrink_policy_ = policy;
+    }
+
+    inline const registry::shrink_policy_info& registry::shrink_policy() const noexcept {
+        return shrink_policy_;
+    }
+
     template < typename T >
     detail::component_storage<T>* registry::find_storage_() noexcept {
         const auto family = detail::type_family<T>::id();
         using raw_storage_ptr = detail::component_storage<T>*;
-        const storage_uptr* storage_uptr_ptr = storages_.find(family);
-        return storage_uptr_ptr && *storage_uptr_ptr
-            ? static_cast<raw_storage_ptr>(storage_uptr_ptr->get())
-            : nullptr;
+        std::size_t slot = detail::type_slot<T>::hint();
+        if ( slot >= storages_.size() || !storages_[slot] || storages_[slot]->family() != family ) {
+            slot = find_storage_slot_(family);
+            if ( slot == storages_.size() ) {
+                return nullptr;
+            }
+            detail::type_slot<T>::remember(slot);
+        }
+        return static_cast<raw_storage_ptr>(storages_[slot].get());
     }
 
     template < typename T >
     const detail::component_storage<T>* registry::find_storage_() const noexcept {
         const auto family = detail::type_family<T>::id();
         using raw_storage_ptr = const detail::component_storage<T>*;
-        const storage_uptr* storage_uptr_ptr = storages_.find(family);
-        return storage_uptr_ptr && *storage_uptr_ptr
-            ? static_cast<raw_storage_ptr>(storage_uptr_ptr->get())
-            : nullptr;
+        std::size_t slot = detail::type_slot<T>::hint();
+        if ( slot >= storages_.size() || !storages_[slot] || storages_[slot]->family() != family ) {
+            slot = find_storage_slot_(family);
+            if ( slot == storages_.size() ) {
+                return nullptr;
+            }
+            detail::type_slot<T>::remember(slot);
+        }
+        return static_cast<raw_storage_ptr>(storages_[slot].get());
     }
 
     template < typename T >
@@ -2919,132 +7703,418 @@ namespace ecs_hpp
             return *storage;
         }
         const auto family = detail::type_family<T>::id();
-        storages_.insert(
-            family,
-            std::make_unique<detail::component_storage<T>>(*this));
-        return *static_cast<detail::component_storage<T>*>(
-            storages_.get(family).get());
+        if ( const std::size_t slot = find_storage_slot_(family); slot < storages_.size() ) {
+            // the storage was compacted, its slot and signature bit are reused
+            storages_[slot] = detail::allocate_unique<detail::component_storage<T>>(resource_, *this, resource_);
+            storages_[slot]->set_family(family);
+            storages_[slot]->set_signature_bit(slot);
+            storages_[slot]->set_growth_policy(growth_policy_, false);
+            storages_[slot]->set_growth_observer(growth_observer_);
+            detail::type_slot<T>::remember(slot);
+            return *static_cast<detail::component_storage<T>*>(storages_[slot].get());
+        }
+        if ( storages_.capacity() == storages_.size() ) {
+            // ensure both capacities before the storage for noexcept insertions
+            const std::size_t capacity = detail::next_capacity_size(
+                storages_.capacity(), storages_.size() + 1u, storages_.max_size());
+            storages_.reserve(capacity);
+            storage_slots_.reserve(capacity);
+        }
+        const auto slot_iter = std::lower_bound(
+            storage_slots_.begin(), storage_slots_.end(),
+            std::make_pair(family, std::size_t(0u)));
+        auto storage = detail::allocate_unique<detail::component_storage<T>>(resource_, *this, resource_);
+        storage->set_family(family);
+        storage->set_signature_bit(storages_.size());
+        storage->set_growth_policy(growth_policy_, false);
+        storage->set_growth_observer(growth_observer_);
+        storage_slots_.insert(slot_iter, std::make_pair(family, storages_.size()));
+        storages_.push_back(std::move(storage));
+        detail::type_slot<T>::remember(storages_.size() - 1u);
+        return *static_cast<detail::component_storage<T>*>(storages_.back().get());
     }
 
-    template < typename F, typename... Opts >
-    void registry::for_joined_components_impl_(
-        std::index_sequence<>,
-        F&& f,
-        Opts&&... opts)
-    {
-        for_each_entity(std::forward<F>(f), std::forward<Opts>(opts)...);
+    template < typename T >
+    detail::component_storage<T>* registry::find_sortable_storage_() {
+        static_assert(
+            !std::is_empty_v<T>,
+            "ecs_hpp (empty components can't be sorted)");
+        static_assert(
+            !detail::is_shared_component_v<T>,
+            "ecs_hpp (shared components can't be sorted)");
+        if ( archetypes_ ) {
+            throw std::logic_error("ecs_hpp::registry (sorting requires the sparse backend)");
+        }
+        detail::component_storage<T>* storage = find_storage_<T>();
+        if ( storage && storage->group() ) {
+            throw std::logic_error("ecs_hpp::registry (grouped components can't be sorted)");
+        }
+        return storage;
     }
 
-    template < typename F, typename... Opts >
-    void registry::for_joined_components_impl_(
-        std::index_sequence<>,
-        F&& f,
-        Opts&&... opts) const
+    inline void registry::shrink_if_sparse_(detail::component_storage_base& storage) noexcept {
+        if ( shrink_policy_.min_occupancy > 0.0 ) {
+            storage.shrink_if_sparse(
+                shrink_policy_.min_occupancy,
+                shrink_policy_.min_capacity);
+        }
+    }
+
+    inline void registry::assure_signature_(std::size_t row, std::size_t bit) {
+        const std::size_t old_capacity = signatures_.capacity();
+        if ( signatures_.assure(row, bit, growth_policy_) && growth_observer_ ) {
+            growth_observer_->on_growth(growth_event{
+                0u, sizeof(std::uint64_t), old_capacity, signatures_.capacity()});
+        }
+    }
+
+    template < typename T >
+    std::size_t registry::instantiation_slot_() {
+        return archetypes_
+            ? 0u
+            : get_or_create_storage_<T>().signature_bit();
+    }
+
+    // a storage reset by `compact` is recreated in the same slot
+    template < typename T, typename V >
+    void registry::instantiate_components_(
+        std::size_t slot,
+        const V& value,
+        const entity_id* first,
+        const entity_id* last)
     {
-        for_each_entity(std::forward<F>(f), std::forward<Opts>(opts)...);
+        if ( archetypes_ ) {
+            assign_components_<T>(first, last, detail::repeat_iterator<V>(value));
+            return;
+        }
+        detail::component_storage<T>* storage = storages_[slot]
+            ? static_cast<detail::component_storage<T>*>(storages_[slot].get())
+            : &get_or_create_storage_<T>();
+        assign_storage_components_(*storage, first, last, detail::repeat_iterator<V>(value));
     }
 
-    template < typename T
-             , typename... Ts
+    inline entity_id registry::recycle_entity_id_() noexcept {
+        assert(free_entity_index_);
+        entity_id& slot = entity_ids_[free_entity_index_];
+        const auto new_ent_id = detail::upgrade_entity_id(
+            detail::entity_id_join(free_entity_index_, detail::entity_id_version(slot)));
+        free_entity_index_ = detail::entity_id_index(slot);
+        slot = new_ent_id;
+        ++entity_count_;
+        return new_ent_id;
+    }
+
+    inline void registry::release_entity_id_(entity_id id) noexcept {
+        const entity_id index = detail::entity_id_index(id);
+        entity_ids_[index] = detail::entity_id_join(
+            free_entity_index_, detail::entity_id_version(id));
+        free_entity_index_ = index;
+        --entity_count_;
+    }
+
+    inline void registry::destroy_entities_(const entity_id* first, const entity_id* last) noexcept {
+        if ( archetypes_ ) {
+            for ( const entity_id* iter = first; iter != last; ++iter ) {
+                archetypes_->remove_all(*iter);
+            }
+        } else if ( first != last ) {
+            // only the storages used by the entities are visited
+            vector_<bool> touched(resource_);
+            bool visit_all = true;
+            try {
+                touched.assign(storages_.size(), false);
+                for ( const entity_id* iter = first; iter != last; ++iter ) {
+                    signatures_.for_each(detail::entity_id_index(*iter), [&touched](std::size_t bit){
+                        touched[bit] = true;
+                    });
+                }
+                visit_all = false;
+            } catch (...) {
+                // every storage is visited then
+            }
+            for ( std::size_t bit = 0; bit < storages_.size(); ++bit ) {
+                const storage_uptr& storage = storages_[bit];
+                if ( storage && storage->count() && (visit_all || touched[bit]) ) {
+                    if ( storage->remove_each(first, last) ) {
+                        shrink_if_sparse_(*storage);
+                    }
+                }
+            }
+            for ( const entity_id* iter = first; iter != last; ++iter ) {
+                signatures_.clear(detail::entity_id_index(*iter));
+            }
+        }
+        for ( const entity_id* iter = first; iter != last; ++iter ) {
+            release_entity_id_(*iter);
+        }
+    }
+
+    inline std::size_t registry::find_storage_slot_(family_id family) const noexcept {
+        const auto slot_iter = std::lower_bound(
+            storage_slots_.begin(), storage_slots_.end(),
+            std::make_pair(family, std::size_t(0u)));
+        return slot_iter != storage_slots_.end() && slot_iter->first == family
+            ? slot_iter->second
+            : storages_.size();
+    }
+
+    template < typename... Ts
              , typename F
              , typename... Opts
-             , std::size_t I
              , std::size_t... Is >
     void registry::for_joined_components_impl_(
-        std::index_sequence<I, Is...>,
+        std::index_sequence<Is...>,
         F&& f,
         Opts&&... opts)
     {
-        const auto ss = std::make_tuple(find_storage_<Ts>()...);
-        if ( detail::tuple_contains(ss, nullptr) ) {
-            return;
+        if constexpr ( sizeof...(Ts) == 0u ) {
+            for_each_entity(std::forward<F>(f), std::forward<Opts>(opts)...);
+        } else if ( archetypes_ ) {
+            archetypes_->for_each<Ts...>([this, &f, &opts...](const entity_id e, auto&&... cs){
+                if ( uentity ent{*this, e}; (... && opts(ent)) ) {
+                    f(ent, cs...);
+                }
+            });
+        } else {
+            const auto ss = std::make_tuple(find_storage_<Ts>()...);
+            if ( detail::tuple_contains(ss, nullptr) ) {
+                return;
+            }
+            const detail::incremental_lock_guards<sizeof...(Ts)> pins(std::get<Is>(ss)->join_locker()...);
+            const detail::joined_driver driver = detail::select_joined_driver(ss);
+            if ( driver.grouped ) {
+                (..., (Is == driver.index
+                    ? for_joined_components_grouped_<Is>(ss, f, opts...)
+                    : void()));
+            } else {
+                (..., (Is == driver.index
+                    ? for_joined_components_driven_<Is>(ss, f, opts...)
+                    : void()));
+            }
         }
-        for_each_component<T>([this, &f, &ss](const uentity& e, T& t) {
-            for_joined_components_impl_<Ts...>(e, f, ss, t);
-        }, std::forward<Opts>(opts)...);
     }
 
-    template < typename T
-             , typename... Ts
+    template < typename... Ts
              , typename F
              , typename... Opts
-             , std::size_t I
              , std::size_t... Is >
     void registry::for_joined_components_impl_(
-        std::index_sequence<I, Is...>,
+        std::index_sequence<Is...>,
         F&& f,
         Opts&&... opts) const
     {
-        const auto ss = std::make_tuple(find_storage_<Ts>()...);
-        if ( detail::tuple_contains(ss, nullptr) ) {
-            return;
+        if constexpr ( sizeof...(Ts) == 0u ) {
+            for_each_entity(std::forward<F>(f), std::forward<Opts>(opts)...);
+        } else if ( archetypes_ ) {
+            std::as_const(*archetypes_).for_each<Ts...>([this, &f, &opts...](const entity_id e, auto&&... cs){
+                if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
+                    f(ent, cs...);
+                }
+            });
+        } else {
+            const auto ss = std::make_tuple(find_storage_<Ts>()...);
+            if ( detail::tuple_contains(ss, nullptr) ) {
+                return;
+            }
+            const detail::incremental_lock_guards<sizeof...(Ts)> pins(std::get<Is>(ss)->join_locker()...);
+            const detail::joined_driver driver = detail::select_joined_driver(ss);
+            if ( driver.grouped ) {
+                (..., (Is == driver.index
+                    ? for_joined_components_grouped_<Is>(ss, f, opts...)
+                    : void()));
+            } else {
+                (..., (Is == driver.index
+                    ? for_joined_components_driven_<Is>(ss, f, opts...)
+                    : void()));
+            }
         }
-        for_each_component<T>([this, &f, &ss](const const_uentity& e, const T& t) {
-            std::as_const(*this).for_joined_components_impl_<Ts...>(e, f, ss, t);
-        }, std::forward<Opts>(opts)...);
     }
 
-    template < typename T
-             , typename... Ts
+    template < std::size_t I
              , typename F
-             , typename Ss
-             , typename... Cs >
-    void registry::for_joined_components_impl_(
-        const uentity& e,
+             , typename... Ts
+             , typename... Opts >
+    void registry::for_joined_components_driven_(
+        const std::tuple<detail::component_storage<Ts>*...>& ss,
         const F& f,
-        const Ss& ss,
-        Cs&... cs)
+        const Opts&... opts)
     {
-        if ( T* c = std::get<0>(ss)->find(e) ) {
-            for_joined_components_impl_<Ts...>(
-                e,
-                f,
-                detail::tuple_tail(ss),
-                cs...,
-                *c);
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if constexpr ( I == 0u ) {
+            std::get<I>(ss)->for_each_component([this, &ss, &f, &opts...](const entity_id e, component_reference<T> t){
+                const auto cs = detail::find_joined_components<I>(
+                    ss, e, detail::component_address(t),
+                    std::make_index_sequence<sizeof...(Ts)>());
+                if ( detail::tuple_contains(cs, nullptr) ) {
+                    return;
+                }
+                if ( uentity ent{*this, e}; (... && opts(ent)) ) {
+                    std::apply([&f, &ent](const auto&... components){
+                        f(ent, *components...);
+                    }, cs);
+                }
+            });
+        } else {
+            // the first storage is locked as if it drove the join, the driver ids
+            // are copied out, so `f` may change the other storages as before
+            vector_<entity_id> ids(resource_);
+            ids.reserve(std::get<I>(ss)->count());
+            std::get<I>(ss)->for_each_component([&ids](const entity_id e, const auto&){
+                ids.push_back(e);
+            });
+            detail::incremental_lock_guard lock(std::get<0>(ss)->locker());
+            for ( const entity_id e : ids ) {
+                const auto cs = std::apply([e](auto*... storages){
+                    return std::make_tuple(storages->find(e)...);
+                }, ss);
+                if ( detail::tuple_contains(cs, nullptr) ) {
+                    continue;
+                }
+                if ( uentity ent{*this, e}; (... && opts(ent)) ) {
+                    std::apply([&f, &ent](const auto&... components){
+                        f(ent, *components...);
+                    }, cs);
+                }
+            }
         }
     }
 
-    template < typename T
-             , typename... Ts
+    template < std::size_t I
              , typename F
-             , typename Ss
-             , typename... Cs >
-    void registry::for_joined_components_impl_(
-        const const_uentity& e,
+             , typename... Ts
+             , typename... Opts >
+    void registry::for_joined_components_driven_(
+        const std::tuple<const detail::component_storage<Ts>*...>& ss,
         const F& f,
-        const Ss& ss,
-        const Cs&... cs) const
+        const Opts&... opts) const
     {
-        if ( const T* c = std::get<0>(ss)->find(e) ) {
-            for_joined_components_impl_<Ts...>(
-                e,
-                f,
-                detail::tuple_tail(ss),
-                cs...,
-                *c);
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if constexpr ( I == 0u ) {
+            std::get<I>(ss)->for_each_component([this, &ss, &f, &opts...](const entity_id e, const_component_reference<T> t){
+                const auto cs = detail::find_joined_components<I>(
+                    ss, e, detail::component_address(t),
+                    std::make_index_sequence<sizeof...(Ts)>());
+                if ( detail::tuple_contains(cs, nullptr) ) {
+                    return;
+                }
+                if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
+                    std::apply([&f, &ent](const auto&... components){
+                        f(ent, *components...);
+                    }, cs);
+                }
+            });
+        } else {
+            // the first storage is locked as if it drove the join, the driver ids
+            // are copied out, so `f` may change the other storages as before
+            vector_<entity_id> ids(resource_);
+            ids.reserve(std::get<I>(ss)->count());
+            std::get<I>(ss)->for_each_component([&ids](const entity_id e, const auto&){
+                ids.push_back(e);
+            });
+            detail::incremental_lock_guard lock(std::get<0>(ss)->locker());
+            for ( const entity_id e : ids ) {
+                const auto cs = std::apply([e](const auto*... storages){
+                    return std::make_tuple(storages->find(e)...);
+                }, ss);
+                if ( detail::tuple_contains(cs, nullptr) ) {
+                    continue;
+                }
+                if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
+                    std::apply([&f, &ent](const auto&... components){
+                        f(ent, *components...);
+                    }, cs);
+                }
+            }
         }
     }
 
-    template < typename F, typename... Cs >
-    void registry::for_joined_components_impl_(
-        const uentity& e,
+    template < std::size_t I
+             , typename F
+             , typename... Ts
+             , typename... Opts >
+    void registry::for_joined_components_grouped_(
+        const std::tuple<detail::component_storage<Ts>*...>& ss,
         const F& f,
-        const std::tuple<>& ss,
-        Cs&... cs)
+        const Opts&... opts)
     {
-        (void)ss;
-        f(e, cs...);
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if constexpr ( !std::is_empty_v<T> ) {
+            // the group keeps its entities at the front of every owned storage
+            detail::component_storage<T>* s = std::get<I>(ss);
+            const detail::component_group_base* g = s->group();
+            detail::incremental_lock_guard lock(s->locker());
+            detail::incremental_lock_guard first_lock(std::get<0>(ss)->locker());
+            for ( std::size_t i = 0, size = g->size(); i < size; ++i ) {
+                const entity_id e = s->id_at(i);
+                const auto cs = std::apply([g, i, e](auto*... storages){
+                    return std::make_tuple(detail::find_grouped_component(*storages, g, i, e)...);
+                }, ss);
+                if ( detail::tuple_contains(cs, nullptr) ) {
+                    continue;
+                }
+                if ( uentity ent{*this, e}; (... && opts(ent)) ) {
+                    std::apply([&f, &ent](const auto&... components){
+                        f(ent, *components...);
+                    }, cs);
+                }
+            }
+        } else {
+            (void)ss; (void)f; ((void)opts, ...);
+            assert(false && "unexpected internal error");
+        }
     }
 
-    template < typename F, typename... Cs >
-    void registry::for_joined_components_impl_(
-        const const_uentity& e,
+    template < std::size_t I
+             , typename F
+             , typename... Ts
+             , typename... Opts >
+    void registry::for_joined_components_grouped_(
+        const std::tuple<const detail::component_storage<Ts>*...>& ss,
         const F& f,
-        const std::tuple<>& ss,
-        const Cs&... cs) const
+        const Opts&... opts) const
     {
-        (void)ss;
-        f(e, cs...);
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if constexpr ( !std::is_empty_v<T> ) {
+            // the group keeps its entities at the front of every owned storage
+            const detail::component_storage<T>* s = std::get<I>(ss);
+            const detail::component_group_base* g = s->group();
+            detail::incremental_lock_guard lock(s->locker());
+            detail::incremental_lock_guard first_lock(std::get<0>(ss)->locker());
+            for ( std::size_t i = 0, size = g->size(); i < size; ++i ) {
+                const entity_id e = s->id_at(i);
+                const auto cs = std::apply([g, i, e](const auto*... storages){
+                    return std::make_tuple(detail::find_grouped_component(*storages, g, i, e)...);
+                }, ss);
+                if ( detail::tuple_contains(cs, nullptr) ) {
+                    continue;
+                }
+                if ( const_uentity ent{*this, e}; (... && opts(ent)) ) {
+                    std::apply([&f, &ent](const auto&... components){
+                        f(ent, *components...);
+                    }, cs);
+                }
+            }
+        } else {
+            (void)ss; (void)f; ((void)opts, ...);
+            assert(false && "unexpected internal error");
+        }
+    }
+
+    template < typename... Args >
+    feature registry::make_feature_(Args&&... args) const {
+        if constexpr ( sizeof...(Args) == 0u ) {
+            return feature(resource_);
+        } else {
+            return feature{std::forward<Args>(args)...};
+        }
+    }
+}
+
+namespace ecs_hpp::detail
+{
+    inline entity_id find_alive_entity_id(const registry& owner, std::size_t index) noexcept {
+        const entity_id* id = owner.entity_ids_.find(index);
+        assert(id && entity_id_index(*id) == index && "unexpected internal error");
+        return *id;
     }
 }
@@ -45,6 +45,90 @@ namespace
             && l.y == r.y;
     }
 
+    struct transform_c {
+        int x{0};
+        int y{0};
+        int z{0};
+    };
+
+    struct anchor_c {
+        int x{0};
+        int y{0};
+    };
+
+    struct sprite_c {
+        int texture{0};
+        int frame{0};
+    };
+
+    struct heavy_c {
+        std::vector<int> values;
+
+        inline static std::size_t copies{0u};
+        inline static std::size_t moves{0u};
+
+        heavy_c() = default;
+        heavy_c(std::size_t n, int v) : values(n, v) {}
+
+        heavy_c(const heavy_c& other) : values(other.values) { ++copies; }
+        heavy_c& operator=(const heavy_c& other) { values = other.values; ++copies; return *this; }
+
+        heavy_c(heavy_c&& other) noexcept : values(std::move(other.values)) { ++moves; }
+        heavy_c& operator=(heavy_c&& other) noexcept { values = std::move(other.values); ++moves; return *this; }
+    };
+
+    template < std::size_t N >
+    struct numbered_c {
+        std::size_t value{N};
+    };
+
+    template < std::size_t... Is >
+    [[maybe_unused]] void assign_numbered_components(
+        ecs::entity& e,
+        bool odd_only,
+        std::index_sequence<Is...>)
+    {
+        (..., (!odd_only || Is % 2u ? void(e.assign_component<numbered_c<Is>>()) : void()));
+    }
+
+    class counting_resource final : public ecs::memory_resource {
+    public:
+        std::size_t allocations() const noexcept {
+            return allocations_;
+        }
+
+        std::size_t allocated_bytes() const noexcept {
+            return allocated_bytes_;
+        }
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations_;
+            allocated_bytes_ += bytes;
+            return ecs::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept override {
+            allocated_bytes_ -= bytes;
+            ecs::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const ecs::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    private:
+        std::size_t allocations_{0u};
+        std::size_t allocated_bytes_{0u};
+    };
+
+    class recording_observer final : public ecs::growth_observer {
+    public:
+        std::vector<ecs::growth_event> events;
+
+        void on_growth(const ecs::growth_event& event) noexcept override {
+            events.push_back(event);
+        }
+    };
+
     struct mult_indexer {
         template < typename T >
         [[maybe_unused]] std::size_t operator()(const T& v) const noexcept {
@@ -59,6 +143,21 @@ namespace
     };
 }
 
+template <>
+struct ecs_hpp::component_traits<transform_c> {
+    using storage_policy = ecs_hpp::soa_storage_policy;
+};
+
+template <>
+struct ecs_hpp::component_traits<anchor_c> {
+    using storage_policy = ecs_hpp::stable_storage_policy;
+};
+
+template <>
+struct ecs_hpp::component_traits<sprite_c> {
+    using storage_policy = ecs_hpp::shared_storage_policy;
+};
+
 TEST_CASE("detail") {
     SUBCASE("get_type_id") {
         using namespace ecs::detail;
@@ -112,13 +211,92 @@ TEST_CASE("detail") {
             REQUIRE(entity_id_index(entity_id_join(10u, 20u)) == 10u);
             REQUIRE(entity_id_version(entity_id_join(10u, 20u)) == 20u);
             REQUIRE(upgrade_entity_id(entity_id_join(10u, 20u)) == entity_id_join(10u, 21u));
-            REQUIRE(upgrade_entity_id(entity_id_join(0u, 1023u)) == entity_id_join(0u, 0u));
-            REQUIRE(upgrade_entity_id(entity_id_join(1u, 1023u)) == entity_id_join(1u, 0u));
-            REQUIRE(upgrade_entity_id(entity_id_join(2048u, 1023u)) == entity_id_join(2048u, 0u));
+            REQUIRE(upgrade_entity_id(entity_id_join(0u, entity_id_version_mask)) == entity_id_join(0u, 0u));
+            REQUIRE(upgrade_entity_id(entity_id_join(1u, entity_id_version_mask)) == entity_id_join(1u, 0u));
+            REQUIRE(upgrade_entity_id(entity_id_join(2048u, entity_id_version_mask)) == entity_id_join(2048u, 0u));
+            REQUIRE(entity_id_index(entity_id_join(entity_id_index_mask, 1u)) == entity_id_index_mask);
+            REQUIRE(entity_id_version(entity_id_join(entity_id_index_mask, 1u)) == 1u);
+        }
+    }
+    SUBCASE("sparse_index") {
+        using namespace ecs::detail;
+        static_assert(std::is_same_v<entity_id_sparse_index, ecs::entity_id>);
+        static_assert(std::is_same_v<default_sparse_index_t<std::uint8_t>, std::uint8_t>);
+        static_assert(std::is_same_v<default_sparse_index_t<std::uint16_t>, std::uint16_t>);
+        static_assert(std::is_same_v<default_sparse_index_t<std::uint32_t>, std::uint32_t>);
+        static_assert(sizeof(default_sparse_index_t<position_c>) == sizeof(std::size_t));
+        {
+            sparse_set<std::uint8_t> s;
+            for ( unsigned i = 0; i < 256u; ++i ) {
+                REQUIRE(s.insert(static_cast<std::uint8_t>(i)));
+            }
+            REQUIRE(s.size() == 256u);
+            REQUIRE(s.get_dense_index(255u) == 255u);
+            REQUIRE(s.unordered_erase(0u));
+            REQUIRE(s.get_dense_index(255u) == 0u);
+        }
+    }
+    SUBCASE("next_capacity_size") {
+        using namespace ecs::detail;
+        using ecs::growth_mode;
+        REQUIRE(next_capacity_size(8u, 9u, 100u) == 16u);
+        REQUIRE(next_capacity_size(60u, 61u, 100u) == 100u);
+        REQUIRE(next_capacity_size(8u, 9u, 100u, {growth_mode::doubling, 0u}) == 16u);
+        REQUIRE(next_capacity_size(8u, 9u, 100u, {growth_mode::one_and_half, 0u}) == 12u);
+        REQUIRE(next_capacity_size(1u, 2u, 100u, {growth_mode::one_and_half, 0u}) == 2u);
+        REQUIRE(next_capacity_size(70u, 71u, 100u, {growth_mode::one_and_half, 0u}) == 100u);
+        REQUIRE(next_capacity_size(8u, 9u, 100u, {growth_mode::fixed_step, 5u}) == 13u);
+        REQUIRE(next_capacity_size(8u, 20u, 100u, {growth_mode::fixed_step, 5u}) == 20u);
+        REQUIRE(next_capacity_size(98u, 99u, 100u, {growth_mode::fixed_step, 5u}) == 100u);
+        REQUIRE(next_capacity_size(0u, 1u, 100u, {growth_mode::reserved, 50u}) == 50u);
+        REQUIRE(next_capacity_size(50u, 51u, 200u, {growth_mode::reserved, 50u}) == 100u);
+        REQUIRE_THROWS_AS(next_capacity_size(0u, 101u, 100u, {growth_mode::fixed_step, 5u}), std::length_error);
+    }
+    SUBCASE("sparse_pages") {
+        using namespace ecs::detail;
+        {
+            sparse_pages<std::size_t, 4u> p;
+            REQUIRE_FALSE(p.page_count());
+            REQUIRE_FALSE(p.find(0u));
+            REQUIRE_FALSE(p.find(42u));
+            REQUIRE_FALSE(p.memory_usage());
+
+            p.assure(42u) = 84u;
+            REQUIRE(p.page_count() == 1u);
+            REQUIRE(p.find(42u));
+            REQUIRE(*p.find(42u) == 84u);
+            REQUIRE(p[42u] == 84u);
+            REQUIRE(p.find(40u));
+            REQUIRE_FALSE(p.find(39u));
+            REQUIRE_FALSE(p.find(44u));
+
+            p.assure(1u) = 2u;
+            REQUIRE(p.page_count() == 2u);
+            REQUIRE(p[1u] == 2u);
+            REQUIRE(p[42u] == 84u);
+
+            sparse_pages<std::size_t, 4u> p2 = p;
+            REQUIRE(p2.page_count() == 2u);
+            REQUIRE(p2[1u] == 2u);
+            REQUIRE(p2[42u] == 84u);
+            REQUIRE(p2.memory_usage() == p.memory_usage());
+
+            sparse_pages<std::size_t, 4u> p3 = std::move(p2);
+            REQUIRE(p3.page_count() == 2u);
+            REQUIRE_FALSE(p2.page_count());
+            REQUIRE_FALSE(p2.find(42u));
         }
     }
     SUBCASE("sparse_set") {
         using namespace ecs::detail;
+        {
+            sparse_set<unsigned> s;
+            REQUIRE(s.insert(4000000u));
+            REQUIRE(s.has(4000000u));
+            REQUIRE_FALSE(s.has(4000001u));
+            REQUIRE_FALSE(s.has(42u));
+            REQUIRE(s.memory_usage() < 4000000u);
+        }
         {
             sparse_set<unsigned, mult_indexer> s{mult_indexer{}};
 
@@ -312,6 +490,244 @@ TEST_CASE("detail") {
             REQUIRE(m.get(84).x == 84);
             REQUIRE(m.size() == 2);
         }
+        {
+            sparse_map<unsigned, int> m;
+            m.insert(21u, 1);
+            m.insert(42u, 2);
+            m.insert(84u, 3);
+            m.unordered_erase(21u);
+
+            unsigned key_sum = 0u;
+            int value_sum = 0;
+            m.for_each([&key_sum, &value_sum](unsigned k, int& v){
+                REQUIRE(v == (k == 42u ? 2 : 3));
+                key_sum += k;
+                value_sum += v;
+                v *= 10;
+            });
+            REQUIRE(key_sum == 126u);
+            REQUIRE(value_sum == 5);
+
+            std::as_const(m).for_each([](unsigned k, const int& v){
+                REQUIRE(v == (k == 42u ? 20 : 30));
+            });
+        }
+        {
+            sparse_map<unsigned, position_c> m;
+            REQUIRE(m.emplace(21u, 1, 2).second);
+            REQUIRE_FALSE(m.emplace(21u, 3, 4).second);
+            REQUIRE(m.get(21u) == position_c(1, 2));
+
+            sparse_map<unsigned, anchor_c> m2;
+            REQUIRE(m2.emplace(42u, 3, 4).first->y == 4);
+        }
+        {
+            sparse_map<unsigned, int> m;
+            REQUIRE(m.insert(5u, 50).second);
+
+            const std::vector<unsigned> ks{1u, 2000u, 3u};
+            const std::vector<int> vs{10, 20, 30};
+            REQUIRE(m.insert_unique(ks.begin(), ks.end(), vs.begin()));
+            REQUIRE(m.size() == 4u);
+            REQUIRE(m.get(1u) == 10);
+            REQUIRE(m.get(2000u) == 20);
+            REQUIRE(m.get(3u) == 30);
+            REQUIRE(m.key_at(3u) == 3u);
+
+            // nothing is inserted with a present or repeated key
+            const std::vector<unsigned> ks2{7u, 5u};
+            const std::vector<unsigned> ks3{7u, 8u, 7u};
+            REQUIRE_FALSE(m.insert_unique(ks2.begin(), ks2.end(), vs.begin()));
+            REQUIRE_FALSE(m.insert_unique(ks3.begin(), ks3.end(), vs.begin()));
+            REQUIRE(m.size() == 4u);
+            REQUIRE_FALSE(m.has(7u));
+            REQUIRE_FALSE(m.has(8u));
+            REQUIRE(m.get(5u) == 50);
+        }
+    }
+    SUBCASE("sparse_bitset") {
+        using namespace ecs::detail;
+        {
+            sparse_bitset<> s;
+            REQUIRE(s.empty());
+            REQUIRE_FALSE(s.has(0u));
+            REQUIRE_FALSE(s.has(100500u));
+            REQUIRE_FALSE(s.erase(42u));
+
+            REQUIRE(s.insert(42u));
+            REQUIRE_FALSE(s.insert(42u));
+            REQUIRE(s.insert(0u));
+            REQUIRE(s.insert(63u));
+            REQUIRE(s.insert(64u));
+            REQUIRE(s.insert(5000u));
+            REQUIRE(s.size() == 5u);
+            REQUIRE(s.has(42u));
+            REQUIRE(s.has(5000u));
+            REQUIRE_FALSE(s.has(4999u));
+
+            std::vector<std::size_t> indices;
+            s.for_each([&indices](std::size_t i){
+                indices.push_back(i);
+            });
+            REQUIRE(indices == std::vector<std::size_t>{0u, 42u, 63u, 64u, 5000u});
+
+            REQUIRE(s.erase(64u));
+            REQUIRE_FALSE(s.erase(64u));
+            REQUIRE_FALSE(s.has(64u));
+            REQUIRE(s.size() == 4u);
+
+            const std::size_t usage = s.memory_usage();
+            s.clear();
+            REQUIRE(s.empty());
+            REQUIRE_FALSE(s.has(42u));
+            REQUIRE(s.memory_usage() == usage);
+
+            indices.clear();
+            s.for_each([&indices](std::size_t i){
+                indices.push_back(i);
+            });
+            REQUIRE(indices.empty());
+        }
+    }
+    SUBCASE("stable_map") {
+        using namespace ecs::detail;
+        {
+            using map_t = stable_map<unsigned, int, sparse_indexer<unsigned>, std::size_t, 64u>;
+            map_t m;
+
+            REQUIRE(m.empty());
+            REQUIRE_FALSE(m.find(1u));
+
+            std::vector<int*> ptrs;
+            for ( unsigned i = 0; i < 200u; ++i ) {
+                ptrs.push_back(m.insert(i, static_cast<int>(i)).first);
+            }
+            REQUIRE(m.size() == 200u);
+            REQUIRE(m.page_count() == 4u);
+            REQUIRE_FALSE(m.insert(5u, 42).second);
+            REQUIRE(m.get(5u) == 5);
+
+            for ( unsigned i = 0; i < 200u; i += 2u ) {
+                REQUIRE(m.unordered_erase(i));
+            }
+            REQUIRE_FALSE(m.unordered_erase(0u));
+            REQUIRE(m.size() == 100u);
+            for ( unsigned i = 1; i < 200u; i += 2u ) {
+                REQUIRE(m.find(i) == ptrs[i]);
+                REQUIRE(*m.find(i) == static_cast<int>(i));
+            }
+
+            // the lowest holes are reused first
+            REQUIRE(m.insert(500u, 500).first == ptrs[0]);
+            REQUIRE(m.insert(501u, 501).first == ptrs[2]);
+            REQUIRE(m.find(501u) == ptrs[2]);
+
+            int sum = 0;
+            std::size_t count = 0u;
+            std::as_const(m).for_each([&sum, &count](unsigned, const int& v){
+                sum += v;
+                ++count;
+            });
+            REQUIRE(count == 102u);
+            REQUIRE(sum == 100 * 100 + 1001);
+
+            map_t m2 = m;
+            REQUIRE(m2.size() == 102u);
+            REQUIRE(m2.get(501u) == 501);
+
+            m.clear();
+            REQUIRE(m.empty());
+            REQUIRE(m.page_count() == 0u);
+        }
+        {
+            using map_t = stable_map<unsigned, int, sparse_indexer<unsigned>, std::size_t, 64u>;
+            map_t m;
+            for ( unsigned i = 0; i < 256u; ++i ) {
+                m.insert(i, 0);
+            }
+            REQUIRE(m.page_count() == 4u);
+
+            // empty pages are released once the map is fragmented enough
+            for ( unsigned i = 0; i < 64u; ++i ) {
+                m.unordered_erase(i + 192u);
+            }
+            REQUIRE(m.page_count() == 4u);
+            for ( unsigned i = 0; i < 64u; ++i ) {
+                m.unordered_erase(i + 64u);
+            }
+            REQUIRE(m.page_count() == 4u);
+            for ( unsigned i = 0; i < 64u; ++i ) {
+                m.unordered_erase(i + 128u);
+            }
+            REQUIRE(m.page_count() == 1u);
+            REQUIRE(m.get(63u) == 0);
+        }
+    }
+    SUBCASE("shrink_to_fit") {
+        using namespace ecs::detail;
+        {
+            sparse_set<unsigned> s;
+            for ( unsigned i = 0; i < 5000u; ++i ) {
+                s.insert(i);
+            }
+            REQUIRE(s.capacity() >= 5000u);
+            for ( unsigned i = 10u; i < 5000u; ++i ) {
+                s.unordered_erase(i);
+            }
+            const std::size_t usage = s.memory_usage();
+            s.shrink_to_fit();
+            REQUIRE(s.capacity() == 10u);
+            REQUIRE(s.memory_usage() < usage);
+            REQUIRE(s.has(9u));
+            REQUIRE_FALSE(s.has(10u));
+            REQUIRE_FALSE(s.has(4999u));
+            REQUIRE(s.insert(4999u));
+            REQUIRE(s.has(4999u));
+
+            s.clear();
+            s.shrink_to_fit();
+            REQUIRE(s.memory_usage() == 0u);
+        }
+        {
+            sparse_bitset<> b;
+            b.insert(3u);
+            b.insert(10000u);
+            REQUIRE(b.capacity() > 10000u);
+            b.erase(10000u);
+            b.shrink_to_fit();
+            REQUIRE(b.capacity() == 64u);
+            REQUIRE(b.has(3u));
+            REQUIRE(b.size() == 1u);
+            b.erase(3u);
+            b.shrink_to_fit();
+            REQUIRE(b.memory_usage() == 0u);
+        }
+        {
+            using map_t = stable_map<unsigned, int, sparse_indexer<unsigned>, std::size_t, 64u>;
+            map_t m;
+            std::vector<int*> ptrs;
+            for ( unsigned i = 0; i < 256u; ++i ) {
+                ptrs.push_back(m.insert(i, static_cast<int>(i)).first);
+            }
+            for ( unsigned i = 70u; i < 256u; ++i ) {
+                m.unordered_erase(i);
+            }
+            m.unordered_erase(10u);
+            REQUIRE(m.capacity() == 256u);
+            REQUIRE(m.page_count() == 2u);
+
+            m.shrink_to_fit();
+            REQUIRE(m.capacity() == 70u);
+            REQUIRE(m.page_count() == 2u);
+            REQUIRE(m.find(69u) == ptrs[69]);
+            REQUIRE(m.get(5u) == 5);
+
+            // the holes below the last used slot are still reused first
+            REQUIRE(m.insert(1000u, 1000).first == ptrs[10]);
+            REQUIRE(m.insert(1001u, 1001).first != nullptr);
+            REQUIRE(m.capacity() == 71u);
+            REQUIRE(m.get(1001u) == 1001);
+        }
     }
 }
 
@@ -402,6 +818,159 @@ TEST_CASE("registry") {
             ecs::registry w;
             using namespace ecs::detail;
 
+            const auto e1 = w.create_entity();
+            const auto e2 = w.create_entity();
+            const auto e3 = w.create_entity();
+
+            // dead slots are recycled in the reverse order
+            w.destroy_entity(e1);
+            w.destroy_entity(e3);
+            REQUIRE_FALSE(w.valid_entity(e1));
+            REQUIRE_FALSE(w.valid_entity(e3));
+            REQUIRE(w.entity_count() == 1u);
+
+            const auto e4 = w.create_entity();
+            const auto e5 = w.create_entity();
+            const auto e6 = w.create_entity();
+            REQUIRE(entity_id_index(e4.id()) == entity_id_index(e3.id()));
+            REQUIRE(entity_id_index(e5.id()) == entity_id_index(e1.id()));
+            REQUIRE(entity_id_index(e6.id()) == entity_id_index(e3.id()) + 1);
+            REQUIRE(entity_id_version(e4.id()) == 1u);
+            REQUIRE(entity_id_version(e5.id()) == 1u);
+            REQUIRE(entity_id_version(e6.id()) == 0u);
+
+            std::vector<ecs::entity_id> ids;
+            w.for_each_entity([&ids](const ecs::entity& e){
+                ids.push_back(e.id());
+            });
+            REQUIRE(ids == std::vector<ecs::entity_id>{e5.id(), e2.id(), e4.id(), e6.id()});
+        }
+        {
+            ecs::registry w;
+            using namespace ecs::detail;
+
+            const auto e1 = w.create_entity();
+            const auto e2 = w.create_entity();
+            w.destroy_entity(e1);
+
+            // recycled ids go first, new ones cross the slot pages
+            const std::vector<ecs::entity> es = w.create_entities(2500u);
+            REQUIRE(es.size() == 2500u);
+            REQUIRE(w.entity_count() == 2501u);
+            REQUIRE(entity_id_index(es[0].id()) == entity_id_index(e1.id()));
+            REQUIRE(entity_id_version(es[0].id()) == 1u);
+            for ( std::size_t i = 1; i < es.size(); ++i ) {
+                REQUIRE(entity_id_index(es[i].id()) == i + 2u);
+                REQUIRE(entity_id_version(es[i].id()) == 0u);
+                REQUIRE(w.valid_entity(es[i]));
+            }
+            REQUIRE(w.valid_entity(e2));
+
+            std::size_t entity_count = 0u;
+            w.for_each_entity([&entity_count](const ecs::entity&){
+                ++entity_count;
+            });
+            REQUIRE(entity_count == 2501u);
+
+            std::vector<ecs::entity> more;
+            w.destroy_entity(es[5]);
+            w.create_entities(0u, std::back_inserter(more));
+            REQUIRE(more.empty());
+            w.create_entities(2u, std::back_inserter(more));
+            REQUIRE(more.size() == 2u);
+            REQUIRE(entity_id_index(more[0].id()) == entity_id_index(es[5].id()));
+            REQUIRE(entity_id_index(more[1].id()) == 2502u);
+        }
+        {
+            ecs::registry w;
+
+            struct throwing_output {
+                std::size_t* left;
+                throwing_output& operator*() noexcept { return *this; }
+                throwing_output& operator++() noexcept { return *this; }
+                throwing_output& operator=(const ecs::entity&) {
+                    if ( !*left ) {
+                        throw std::bad_alloc();
+                    }
+                    --*left;
+                    return *this;
+                }
+            };
+
+            // the entities not written out are destroyed
+            std::size_t left = 3u;
+            REQUIRE_THROWS_AS(w.create_entities(10u, throwing_output{&left}), std::bad_alloc);
+            REQUIRE(w.entity_count() == 3u);
+            std::vector<ecs::entity> es;
+            w.for_each_entity([&es](const ecs::entity& e){
+                es.push_back(e);
+            });
+            for ( const ecs::entity& e : es ) {
+                w.destroy_entity(e);
+            }
+            left = 4u;
+            REQUIRE_THROWS_AS(w.create_entities(10u, throwing_output{&left}), std::bad_alloc);
+            REQUIRE(w.entity_count() == 4u);
+        }
+        for ( const ecs::registry_backend backend : {ecs::registry_backend::sparse, ecs::registry_backend::archetype} ) {
+            ecs::registry w(backend);
+            using namespace ecs::detail;
+
+            std::vector<ecs::entity> es = w.create_entities(10u);
+            for ( std::size_t i = 0; i < es.size(); ++i ) {
+                es[i].assign_component<position_c>(int(i), 0);
+                if ( i % 2u ) {
+                    es[i].assign_component<velocity_c>(int(i), 0);
+                }
+                if ( i % 3u ) {
+                    es[i].assign_component<movable_c>();
+                }
+            }
+            if ( backend == ecs::registry_backend::sparse ) {
+                w.group<position_c, velocity_c>();
+            }
+
+            // the released ids are recycled in the reverse order
+            w.destroy_entities(es.begin() + 2, es.begin() + 7);
+            w.destroy_entities(es.end(), es.end());
+            REQUIRE(w.entity_count() == 5u);
+            REQUIRE(w.component_count<position_c>() == 5u);
+            REQUIRE(w.component_count<velocity_c>() == 3u);
+            REQUIRE(w.component_count<movable_c>() == 3u);
+            for ( std::size_t i = 0; i < es.size(); ++i ) {
+                const bool alive = i < 2u || i >= 7u;
+                REQUIRE(w.valid_entity(es[i]) == alive);
+                if ( alive ) {
+                    REQUIRE(es[i].get_component<position_c>().x == int(i));
+                    REQUIRE(es[i].exists_component<velocity_c>() == (i % 2u == 1u));
+                    REQUIRE(es[i].exists_component<movable_c>() == (i % 3u != 0u));
+                }
+            }
+            std::size_t joined_count = 0u;
+            w.for_joined_components<position_c, velocity_c>([&joined_count](
+                const ecs::entity&, const position_c& p, const velocity_c& v)
+            {
+                REQUIRE(p.x == v.x);
+                ++joined_count;
+            });
+            REQUIRE(joined_count == 3u);
+
+            const ecs::entity e = w.create_entity();
+            REQUIRE(entity_id_index(e.id()) == entity_id_index(es[6].id()));
+            REQUIRE(entity_id_version(e.id()) == 1u);
+            REQUIRE_FALSE(e.exists_component<position_c>());
+
+            const std::vector<ecs::entity_id> ids{es[0].id(), es[7].id()};
+            w.destroy_entities(ids.begin(), ids.end());
+            REQUIRE(w.entity_count() == 4u);
+            REQUIRE(w.component_count<position_c>() == 3u);
+            REQUIRE(w.component_count<velocity_c>() == 2u);
+            REQUIRE(w.component_count<movable_c>() == 2u);
+        }
+        if constexpr ( ecs::entity_id_version_bits <= 16u ) {
+            ecs::registry w;
+            using namespace ecs::detail;
+
             auto e = w.create_entity();
             const auto e_id = e.id();
             for ( std::size_t i = 0; i < entity_id_version_mask; ++i ) {
@@ -414,7 +983,7 @@ TEST_CASE("registry") {
             e = w.create_entity();
             REQUIRE(entity_id_version(e_id) == entity_id_version(e.id()));
         }
-        {
+        if constexpr ( ecs::entity_id_index_bits <= 24u ) {
             ecs::registry w;
             using namespace ecs::detail;
 
@@ -736,6 +1305,49 @@ TEST_CASE("registry") {
             REQUIRE(c1 == position_c(1,2));
             REQUIRE(c2 == velocity_c(0,0));
         }
+        for ( const ecs::registry_backend backend : {ecs::registry_backend::sparse, ecs::registry_backend::archetype} ) {
+            ecs::registry w(backend);
+
+            const auto p1 = ecs::prototype()
+                .component<position_c>(1,2)
+                .component<velocity_c>(3,4)
+                .component<movable_c>();
+
+            const ecs::compiled_prototype cp1(w, p1);
+            REQUIRE(&cp1.owner() == &w);
+            REQUIRE(cp1.component_count() == 3u);
+            REQUIRE(ecs::compiled_prototype(w, ecs::prototype()).empty());
+
+            const ecs::entity e1 = w.create_entity(cp1);
+            REQUIRE(e1.get_component<position_c>() == position_c(1,2));
+            REQUIRE(e1.get_component<velocity_c>() == velocity_c(3,4));
+            REQUIRE(e1.exists_component<movable_c>());
+
+            w.destroy_entity(e1);
+            if ( backend == ecs::registry_backend::sparse ) {
+                // the storage slots survive compaction
+                REQUIRE(w.compact() == 3u);
+            }
+
+            const std::vector<ecs::entity> es = w.create_entities(cp1, 1500u);
+            REQUIRE(w.entity_count() == 1500u);
+            REQUIRE(w.component_count<position_c>() == 1500u);
+            REQUIRE(w.component_count<velocity_c>() == 1500u);
+            REQUIRE(w.component_count<movable_c>() == 1500u);
+            for ( const ecs::entity& e : es ) {
+                REQUIRE(w.exists_all_components<position_c, velocity_c, movable_c>(e));
+                REQUIRE(e.get_component<position_c>() == position_c(1,2));
+            }
+
+            std::size_t joined_count = 0u;
+            w.for_joined_components<position_c, velocity_c>([&joined_count](
+                const ecs::entity&, const position_c&, const velocity_c& v)
+            {
+                REQUIRE(v == velocity_c(3,4));
+                ++joined_count;
+            });
+            REQUIRE(joined_count == 1500u);
+        }
     }
     SUBCASE("component_assigning") {
         {
@@ -830,6 +1442,45 @@ TEST_CASE("registry") {
 
             e1.destroy();
         }
+        for ( const ecs::registry_backend backend : {ecs::registry_backend::sparse, ecs::registry_backend::archetype} ) {
+            ecs::registry w(backend);
+
+            const std::vector<ecs::entity> es = w.create_entities(4u);
+            std::vector<position_c> ps{{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+            if ( backend == ecs::registry_backend::sparse ) {
+                w.group<position_c, velocity_c>();
+            }
+
+            w.assign_components<position_c>(es.begin(), es.end(), ps.begin());
+            const std::vector<movable_c> ms(2u);
+            w.assign_components<movable_c>(es.begin(), es.begin() + 2, ms.begin());
+            for ( std::size_t i = 0; i < es.size(); ++i ) {
+                REQUIRE(es[i].get_component<position_c>() == ps[i]);
+                REQUIRE(es[i].exists_component<movable_c>() == (i < 2u));
+            }
+
+            // present components are assigned, the values are moved by move iterators
+            const std::vector<ecs::entity_id> ids{es[3].id(), es[1].id(), es[3].id()};
+            const std::vector<velocity_c> vs{{1, 1}, {2, 2}, {3, 3}};
+            w.assign_components<position_c>(ids.begin(), ids.end(), std::make_move_iterator(ps.begin()));
+            w.assign_components<velocity_c>(ids.begin(), ids.end(), vs.begin());
+            REQUIRE(w.component_count<position_c>() == 4u);
+            REQUIRE(w.component_count<velocity_c>() == 2u);
+            REQUIRE(es[1].get_component<position_c>() == position_c(3, 4));
+            REQUIRE(es[3].get_component<position_c>() == position_c(5, 6));
+            REQUIRE(es[1].get_component<velocity_c>() == velocity_c(2, 2));
+            REQUIRE(es[3].get_component<velocity_c>() == velocity_c(3, 3));
+            REQUIRE(w.exists_all_components<position_c, velocity_c>(es[1]));
+            REQUIRE_FALSE(w.exists_any_components<velocity_c>(es[0]));
+
+            std::size_t joined_count = 0u;
+            w.for_joined_components<position_c, velocity_c>([&joined_count](
+                const ecs::entity&, const position_c&, const velocity_c&)
+            {
+                ++joined_count;
+            });
+            REQUIRE(joined_count == 2u);
+        }
     }
     SUBCASE("component_ensuring") {
         {
@@ -856,6 +1507,58 @@ TEST_CASE("registry") {
             REQUIRE(c1.get() == velocity_c(20, 10));
         }
     }
+    SUBCASE("component_emplacing") {
+        {
+            heavy_c::copies = heavy_c::moves = 0u;
+
+            ecs::registry w;
+            ecs::entity e1 = w.create_entity();
+
+            REQUIRE(e1.assign_component<heavy_c>(3u, 7).values == std::vector<int>{7, 7, 7});
+            REQUIRE(e1.ensure_component<heavy_c>(5u, 1).values.size() == 3u);
+            REQUIRE(heavy_c::copies == 0u);
+            REQUIRE(heavy_c::moves == 0u);
+
+            const heavy_c h(2u, 4);
+            const int* data = e1.get_component<heavy_c>().values.data();
+            REQUIRE(e1.assign_component<heavy_c>(h).values == h.values);
+            REQUIRE(e1.get_component<heavy_c>().values.data() == data);
+            REQUIRE(heavy_c::copies == 1u);
+            REQUIRE(heavy_c::moves == 0u);
+
+            e1.update_component<heavy_c>([](heavy_c& c){
+                c.values.push_back(5);
+            });
+            REQUIRE(e1.get_component<heavy_c>().values == std::vector<int>{4, 4, 5});
+            REQUIRE(e1.get_component<heavy_c>().values.data() == data);
+
+            ecs::entity e2 = w.create_entity();
+            REQUIRE(e2.update_component<heavy_c>([](heavy_c& c){
+                c.values.push_back(1);
+            }, 1u, 2).values == std::vector<int>{2, 1});
+            REQUIRE(heavy_c::copies == 1u);
+
+            ecs::component<position_c> c1 = w.wrap_component<position_c>(e2);
+            c1.update([](position_c& p){ p.x += 10; }, 1, 2);
+            c1.update([](position_c& p){ p.y += 10; });
+            REQUIRE(c1.get() == position_c(11, 12));
+        }
+        {
+            ecs::registry w;
+            ecs::entity e1 = w.create_entity();
+
+            e1.assign_component<anchor_c>(1, 2);
+            e1.update_component<anchor_c>([](anchor_c& a){ a.y = 5; });
+            REQUIRE(e1.get_component<anchor_c>().x == 1);
+            REQUIRE(e1.get_component<anchor_c>().y == 5);
+
+            e1.assign_component<transform_c>(1, 2, 3);
+            e1.update_component<transform_c>([](ecs::soa_reference<transform_c> t){
+                t.get<2>() = 6;
+            });
+            REQUIRE(e1.get_component<transform_c>().load().z == 6);
+        }
+    }
     SUBCASE("component_accessing") {
         {
             ecs::registry w;
@@ -1010,6 +1713,116 @@ TEST_CASE("registry") {
             REQUIRE_FALSE(e3.exists_component<velocity_c>());
             REQUIRE(e3.get_component<position_c>() == position_c(1, 2));
         }
+        for ( const ecs::registry_backend backend : {ecs::registry_backend::sparse, ecs::registry_backend::archetype} ) {
+            ecs::registry w(backend);
+
+            auto e1 = w.create_entity();
+            ecs::entity_filler(e1)
+                .component<position_c>(1, 2)
+                .component<movable_c>()
+                .component<anchor_c>(anchor_c{5, 6})
+                .component<sprite_c>(sprite_c{7, 8});
+            w.create_entity().assign_component<velocity_c>(3, 4);
+            if ( backend == ecs::registry_backend::sparse ) {
+                w.group<position_c, velocity_c>();
+            }
+
+            const std::vector<ecs::entity> es = w.clone_entities(e1, 2000u);
+            REQUIRE(es.size() == 2000u);
+            REQUIRE(w.entity_count() == 2002u);
+            REQUIRE(w.component_count<position_c>() == 2001u);
+            REQUIRE(w.component_count<movable_c>() == 2001u);
+            REQUIRE(w.component_count<anchor_c>() == 2001u);
+            REQUIRE(w.component_count<sprite_c>() == 2001u);
+            REQUIRE(w.component_count<velocity_c>() == 1u);
+            for ( const ecs::entity& e : es ) {
+                REQUIRE(w.exists_all_components<position_c, movable_c, anchor_c, sprite_c>(e));
+                REQUIRE_FALSE(w.exists_any_components<velocity_c>(e));
+                REQUIRE(e.get_component<position_c>() == position_c(1, 2));
+                REQUIRE(e.get_component<anchor_c>().y == 6);
+                REQUIRE(e.get_component<sprite_c>().frame == 8);
+            }
+            if ( backend == ecs::registry_backend::sparse ) {
+                REQUIRE(w.component_use_count<sprite_c>(e1) == 2001u);
+            }
+
+            std::vector<ecs::entity> es2;
+            w.clone_entities(es[0], 0u, std::back_inserter(es2));
+            w.clone_entities(w.create_entity(), 3u, std::back_inserter(es2));
+            REQUIRE(es2.size() == 3u);
+            REQUIRE(w.entity_count() == 2006u);
+            REQUIRE(w.component_count<position_c>() == 2001u);
+        }
+    }
+    SUBCASE("forking") {
+        for ( const ecs::registry_backend backend : {ecs::registry_backend::sparse, ecs::registry_backend::archetype} ) {
+            ecs::registry w(backend);
+
+            std::vector<ecs::entity> es = w.create_entities(3000u);
+            for ( std::size_t i = 0; i < es.size(); ++i ) {
+                const int v = static_cast<int>(i);
+                es[i].assign_component<position_c>(v, v);
+                if ( i % 2u ) {
+                    ecs::entity_filler(es[i])
+                        .component<velocity_c>(v, -v)
+                        .component<movable_c>()
+                        .component<anchor_c>(anchor_c{v, v})
+                        .component<sprite_c>(sprite_c{v, v});
+                }
+            }
+            if ( backend == ecs::registry_backend::sparse ) {
+                w.group<position_c, velocity_c>();
+            }
+            w.destroy_entity(es[10]);
+            w.destroy_entity(es[20]);
+
+            ecs::registry f = w.fork();
+            REQUIRE(f.backend() == backend);
+            REQUIRE(f.entity_count() == 2998u);
+            REQUIRE(f.component_count<position_c>() == 2998u);
+            REQUIRE(f.component_count<velocity_c>() == 1500u);
+            REQUIRE(f.component_count<movable_c>() == 1500u);
+            REQUIRE(f.component_count<sprite_c>() == 1500u);
+
+            std::vector<ecs::entity_id> wids;
+            std::vector<ecs::entity_id> fids;
+            w.for_joined_components<position_c, velocity_c>([&wids](ecs::entity e, const position_c&, const velocity_c&){
+                wids.push_back(e.id());
+            });
+            f.for_joined_components<position_c, velocity_c>([&f, &fids](ecs::entity e, const position_c& p, const velocity_c& v){
+                REQUIRE(&e.owner() == &f);
+                REQUIRE(p.x == v.x);
+                fids.push_back(e.id());
+            });
+            REQUIRE(wids == fids);
+
+            ecs::entity fe = f.wrap_entity(es[11].id());
+            REQUIRE(f.valid_entity(fe));
+            REQUIRE_FALSE(f.valid_entity(es[10].id()));
+            REQUIRE(fe.get_component<anchor_c>().y == 11);
+            REQUIRE(fe.get_component<sprite_c>().frame == 11);
+
+            fe.get_component<position_c>().x = 42;
+            fe.remove_component<velocity_c>();
+            if ( backend == ecs::registry_backend::sparse ) {
+                REQUIRE(w.component_use_count<sprite_c>(es[11]) == 2u);
+                f.detach_component<sprite_c>(fe).frame = 7;
+                REQUIRE(w.component_use_count<sprite_c>(es[11]) == 1u);
+            } else {
+                f.assign_component<sprite_c>(fe, sprite_c{7, 7});
+            }
+            REQUIRE(es[11].get_component<position_c>().x == 11);
+            REQUIRE(es[11].exists_component<velocity_c>());
+            REQUIRE(es[11].get_component<sprite_c>().frame == 11);
+            REQUIRE(fe.get_component<sprite_c>().frame == 7);
+            REQUIRE(f.component_count<velocity_c>() == 1499u);
+            REQUIRE(w.component_count<velocity_c>() == 1500u);
+
+            // both registries recycle the same ids
+            REQUIRE(w.create_entity().id() == f.create_entity().id());
+            REQUIRE(w.create_entity().id() == f.create_entity().id());
+            REQUIRE(w.create_entity().id() == f.create_entity().id());
+        }
     }
     SUBCASE("for_each_entity") {
         {
@@ -1191,30 +2004,737 @@ TEST_CASE("registry") {
             {
             });
         }
-    }
-    SUBCASE("aspects") {
         {
-            using empty_aspect = ecs::aspect<>;
-
             ecs::registry w;
 
-            ecs::entity e1 = w.create_entity();
-            REQUIRE(empty_aspect::match_entity(e1));
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+            auto e3 = w.create_entity();
 
-            ecs::entity e2 = w.create_entity();
-            e2.assign_component<movable_c>();
-            e2.assign_component<position_c>(1,2);
-            REQUIRE(empty_aspect::match_entity(e2));
+            e1.assign_component<position_c>(1, 2);
+            e2.assign_component<position_c>(3, 4);
+            e3.assign_component<position_c>(5, 6);
 
-            ecs::entity e3 = w.create_entity();
-            e3.assign_component<movable_c>();
-            e3.assign_component<position_c>(1,2);
-            e3.assign_component<velocity_c>(3,4);
-            REQUIRE(empty_aspect::match_entity(e3));
+            e3.assign_component<velocity_c>(7, 8);
+            e1.assign_component<velocity_c>(9, 10);
+            e1.assign_component<movable_c>();
 
             {
-                ecs::entity_id acc{};
-                empty_aspect::for_each_entity(w, [&acc](ecs::entity e){
+                std::vector<ecs::entity_id> ids;
+                w.for_joined_components<position_c, velocity_c>([&ids](
+                    ecs::entity e, position_c& p, const velocity_c& v)
+                {
+                    p.y = v.y;
+                    ids.push_back(e.id());
+                });
+                // driven by the smallest storage
+                REQUIRE(ids == std::vector<ecs::entity_id>{e3.id(), e1.id()});
+                REQUIRE(e1.get_component<position_c>().y == 10);
+                REQUIRE(e2.get_component<position_c>().y == 4);
+                REQUIRE(e3.get_component<position_c>().y == 8);
+            }
+
+            {
+                std::vector<ecs::entity_id> ids;
+                std::as_const(w).for_joined_components<position_c, velocity_c, movable_c>([&ids](
+                    ecs::const_entity e, const position_c& p, const velocity_c& v, const movable_c&)
+                {
+                    REQUIRE(p.x == 1);
+                    REQUIRE(v.x == 9);
+                    ids.push_back(e.id());
+                });
+                REQUIRE(ids == std::vector<ecs::entity_id>{e1.id()});
+            }
+
+            {
+                std::vector<ecs::entity_id> ids;
+                w.for_joined_components<movable_c, position_c>([&ids](
+                    ecs::entity e, movable_c&, position_c&)
+                {
+                    ids.push_back(e.id());
+                }, !ecs::exists<velocity_c>{});
+                REQUIRE(ids.empty());
+            }
+        }
+        {
+            ecs::registry w;
+
+            std::vector<ecs::entity> es = w.create_entities(10u);
+            for ( std::size_t i = 0; i < es.size(); ++i ) {
+                es[i].assign_component<position_c>(int(i), 0);
+                if ( i % 3u == 0u ) {
+                    es[i].assign_component<velocity_c>(int(i), 0);
+                    es[i].assign_component<movable_c>();
+                }
+            }
+
+            // only the first storage is locked, whatever storage drives the join
+            std::size_t joined_count = 0u;
+            w.for_joined_components<position_c, velocity_c>([&joined_count](
+                ecs::entity e, const position_c& p, const velocity_c& v)
+            {
+                REQUIRE(p.x == v.x);
+                e.remove_component<velocity_c>();
+                ++joined_count;
+            });
+            REQUIRE(joined_count == 4u);
+            REQUIRE(w.component_count<velocity_c>() == 0u);
+
+            joined_count = 0u;
+            w.for_joined_components<position_c, movable_c>([&w, &joined_count](
+                ecs::entity e, const position_c&, const movable_c&)
+            {
+                e.remove_component<movable_c>();
+                REQUIRE(w.compact() == 0u);
+                ++joined_count;
+            });
+            REQUIRE(joined_count == 4u);
+            REQUIRE(w.component_count<movable_c>() == 0u);
+            REQUIRE(w.compact() == 2u);
+        }
+    }
+    SUBCASE("groups") {
+        struct mass_c {
+            int m{0};
+            mass_c() = default;
+            mass_c(int nm) : m(nm) {}
+        };
+        {
+            ecs::registry w;
+
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+            auto e3 = w.create_entity();
+            auto e4 = w.create_entity();
+
+            e1.assign_component<position_c>(1, 2);
+            e2.assign_component<position_c>(5, 6);
+            e2.assign_component<velocity_c>(7, 8);
+            e3.assign_component<velocity_c>(9, 10);
+
+            w.group<position_c, velocity_c>();
+            REQUIRE_NOTHROW(w.group<position_c, velocity_c>());
+            REQUIRE_NOTHROW(w.group<velocity_c, position_c>());
+            REQUIRE_THROWS_AS((w.group<position_c, mass_c>()), std::logic_error);
+            REQUIRE_THROWS_AS((w.group<velocity_c, position_c, mass_c>()), std::logic_error);
+
+            const auto joined_ids = [&w](){
+                std::vector<ecs::entity_id> ids;
+                w.for_joined_components<velocity_c, position_c>([&ids](
+                    ecs::entity_id id, const velocity_c& v, const position_c& p)
+                {
+                    REQUIRE(p.x + 2 == v.x);
+                    ids.push_back(id);
+                });
+                return ids;
+            };
+
+            REQUIRE(joined_ids() == std::vector<ecs::entity_id>{e2.id()});
+
+            e1.assign_component<velocity_c>(3, 4);
+            e3.assign_component<position_c>(7, 8);
+            e4.assign_component<position_c>(9, 10);
+            REQUIRE(joined_ids() == std::vector<ecs::entity_id>{e2.id(), e1.id(), e3.id()});
+
+            e2.remove_component<position_c>();
+            REQUIRE(joined_ids() == std::vector<ecs::entity_id>{e3.id(), e1.id()});
+
+            e1.destroy();
+            REQUIRE(joined_ids() == std::vector<ecs::entity_id>{e3.id()});
+
+            e4.assign_component<velocity_c>(11, 12);
+            REQUIRE(joined_ids() == std::vector<ecs::entity_id>{e3.id(), e4.id()});
+
+            {
+                std::vector<ecs::entity_id> ids;
+                w.for_joined_components<position_c, velocity_c>([&ids](
+                    ecs::entity_id id, position_c& p, const velocity_c& v)
+                {
+                    p.x = v.x;
+                    ids.push_back(id);
+                }, !ecs::exists<mass_c>{});
+                REQUIRE(ids == std::vector<ecs::entity_id>{e3.id(), e4.id()});
+                REQUIRE(e3.get_component<position_c>().x == 9);
+                REQUIRE(e4.get_component<position_c>().x == 11);
+            }
+
+            {
+                e4.assign_component<mass_c>(42);
+                std::vector<ecs::entity_id> ids;
+                std::as_const(w).for_joined_components<position_c, mass_c, velocity_c>([&ids](
+                    ecs::const_entity e, const position_c&, const mass_c& m, const velocity_c&)
+                {
+                    REQUIRE(m.m == 42);
+                    ids.push_back(e.id());
+                });
+                REQUIRE(ids == std::vector<ecs::entity_id>{e4.id()});
+            }
+
+            w.remove_all_components<velocity_c>();
+            REQUIRE(joined_ids().empty());
+
+            e2.assign_component<position_c>(1, 2);
+            e2.assign_component<velocity_c>(3, 4);
+            REQUIRE(joined_ids() == std::vector<ecs::entity_id>{e2.id()});
+            REQUIRE(w.component_count<position_c>() == 3u);
+            REQUIRE(w.component_count<velocity_c>() == 1u);
+        }
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            e1.assign_component<position_c>(1, 2);
+            e1.assign_component<velocity_c>(3, 4);
+            w.group<position_c, velocity_c>();
+
+            auto e2 = w.create_entity(e1);
+            REQUIRE(e2.get_component<position_c>() == position_c(1, 2));
+            REQUIRE(e2.get_component<velocity_c>() == velocity_c(3, 4));
+
+            std::size_t count = 0u;
+            w.for_joined_components<position_c, velocity_c>([&count](
+                ecs::entity, const position_c&, const velocity_c&)
+            {
+                ++count;
+            });
+            REQUIRE(count == 2u);
+        }
+    }
+    SUBCASE("sorting") {
+        {
+            ecs::registry w;
+            const auto position_xs = [&w](){
+                std::vector<int> xs;
+                w.for_each_component<position_c>([&xs](ecs::entity, const position_c& p){
+                    xs.push_back(p.x);
+                });
+                return xs;
+            };
+
+            REQUIRE_NOTHROW(w.sort_components<position_c>([](const position_c&, const position_c&){
+                return false;
+            }));
+
+            std::vector<ecs::entity> es;
+            for ( int x : {5, 3, 8, 1, 9, 2, 7} ) {
+                es.push_back(w.create_entity());
+                es.back().assign_component<position_c>(x, -x);
+            }
+
+            w.sort_components<position_c>([](const position_c& l, const position_c& r){
+                return l.x < r.x;
+            });
+            REQUIRE(position_xs() == std::vector<int>{1, 2, 3, 5, 7, 8, 9});
+            for ( const auto& e : es ) {
+                REQUIRE(e.get_component<position_c>().x == -e.get_component<position_c>().y);
+            }
+
+            w.sort_components_by_id<position_c>([](ecs::entity_id l, ecs::entity_id r){
+                return l > r;
+            });
+            REQUIRE(position_xs() == std::vector<int>{7, 2, 9, 1, 8, 3, 5});
+
+            es[4].assign_component<velocity_c>();
+            es[0].assign_component<velocity_c>();
+            es[2].assign_component<velocity_c>();
+            w.sort_components_as<position_c, velocity_c>();
+            const std::vector<int> xs = position_xs();
+            REQUIRE(xs.size() == 7u);
+            REQUIRE(std::vector<int>(xs.begin(), xs.begin() + 3) == std::vector<int>{9, 5, 8});
+
+            es[1].remove_component<position_c>();
+            REQUIRE_FALSE(es[1].exists_component<position_c>());
+            REQUIRE(es[3].get_component<position_c>() == position_c(1, -1));
+        }
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+            e1.assign_component<transform_c>(3, 0, 0);
+            e2.assign_component<transform_c>(1, 0, 0);
+            w.sort_components<transform_c>([](
+                ecs::soa_reference<const transform_c> l,
+                ecs::soa_reference<const transform_c> r)
+            {
+                return l.get<0>() < r.get<0>();
+            });
+            std::vector<ecs::entity_id> ids;
+            w.for_each_component<transform_c>([&ids](ecs::entity e, const auto&){
+                ids.push_back(e.id());
+            });
+            REQUIRE(ids == std::vector<ecs::entity_id>{e2.id(), e1.id()});
+            REQUIRE(e1.get_component<transform_c>().get<0>() == 3);
+        }
+        {
+            ecs::registry w;
+            w.create_entity().assign_component<position_c>();
+            w.group<position_c, velocity_c>();
+            REQUIRE_THROWS_AS(w.sort_components_by_id<position_c>(std::less<>()), std::logic_error);
+            REQUIRE_THROWS_AS((w.sort_components_as<velocity_c, position_c>()), std::logic_error);
+        }
+        {
+            ecs::registry w(ecs::registry_backend::archetype);
+            w.create_entity().assign_component<position_c>();
+            REQUIRE_THROWS_AS(w.sort_components_by_id<position_c>(std::less<>()), std::logic_error);
+        }
+    }
+    SUBCASE("soa_components") {
+        static_assert(std::is_same_v<
+            ecs::component_reference<transform_c>,
+            ecs::soa_reference<transform_c>>);
+        static_assert(std::is_same_v<
+            ecs::component_reference<position_c>,
+            position_c&>);
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+
+            e1.assign_component<transform_c>(1, 2, 3);
+            e2.assign_component<transform_c>(transform_c{4, 5, 6});
+            e2.assign_component<position_c>(7, 8);
+
+            REQUIRE(e1.get_component<transform_c>().get<0>() == 1);
+            REQUIRE(e1.get_component<transform_c>().load().z == 3);
+            REQUIRE(std::as_const(e2).get_component<transform_c>().get<1>() == 5);
+            REQUIRE(e1.find_component<transform_c>()->get<2>() == 3);
+            REQUIRE_FALSE(e1.find_component<position_c>());
+            REQUIRE_FALSE(w.create_entity().find_component<transform_c>());
+
+            {
+                auto [x, y, z] = e1.get_component<transform_c>();
+                x = 10; y = 20; z = 30;
+                const transform_c t = e1.get_component<transform_c>();
+                REQUIRE((t.x == 10 && t.y == 20 && t.z == 30));
+            }
+
+            e1.get_component<transform_c>() = transform_c{1, 1, 1};
+            e2.get_component<transform_c>() = e1.get_component<transform_c>();
+            REQUIRE(e2.get_component<transform_c>().load().z == 1);
+            REQUIRE(e2.ensure_component<transform_c>(9, 9, 9).get<0>() == 1);
+
+            int sum = 0;
+            w.for_each_component<transform_c>([&sum](
+                ecs::entity, ecs::soa_reference<transform_c> t)
+            {
+                t.get<0>() += 1;
+                sum += t.get<0>();
+            });
+            REQUIRE(sum == 4);
+
+            std::vector<ecs::entity_id> ids;
+            std::as_const(w).for_joined_components<position_c, transform_c>([&ids](
+                ecs::const_entity e, const position_c& p, ecs::soa_reference<const transform_c> t)
+            {
+                REQUIRE(p.x == 7);
+                REQUIRE(t.get<0>() == 2);
+                ids.push_back(e.id());
+            });
+            REQUIRE(ids == std::vector<ecs::entity_id>{e2.id()});
+
+            auto e3 = w.create_entity(e2);
+            REQUIRE(e3.get_component<transform_c>().load().x == 2);
+            REQUIRE(w.component_count<transform_c>() == 3u);
+
+            REQUIRE(e1.remove_component<transform_c>());
+            REQUIRE_FALSE(e1.exists_component<transform_c>());
+            REQUIRE(e2.get_component<transform_c>().get<0>() == 2);
+            REQUIRE(e3.get_component<transform_c>().get<0>() == 2);
+        }
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+            e1.assign_component<transform_c>(1, 2, 3);
+            e2.assign_component<transform_c>(4, 5, 6);
+            e2.assign_component<velocity_c>(7, 8);
+            w.group<velocity_c, transform_c>();
+
+            w.for_joined_components<transform_c, velocity_c>([](
+                ecs::entity, auto t, velocity_c& v)
+            {
+                v.x = t.template get<0>();
+                t = transform_c{v.y, v.y, v.y};
+            });
+            REQUIRE(e2.get_component<velocity_c>().x == 4);
+            REQUIRE(e2.get_component<transform_c>().get<2>() == 8);
+            REQUIRE(e1.get_component<transform_c>().get<2>() == 3);
+        }
+    }
+    SUBCASE("stable_components") {
+        ecs::registry w;
+
+        std::vector<ecs::entity> es;
+        std::vector<anchor_c*> ptrs;
+        for ( int i = 0; i < 3000; ++i ) {
+            es.push_back(w.create_entity());
+            ptrs.push_back(&es.back().assign_component<anchor_c>(anchor_c{i, i}));
+            es.back().assign_component<position_c>(i, i);
+        }
+
+        for ( std::size_t i = 0; i < es.size(); i += 3u ) {
+            es[i].destroy();
+        }
+        for ( int i = 0; i < 1000; ++i ) {
+            w.create_entity().assign_component<anchor_c>(anchor_c{-1, -1});
+        }
+
+        for ( std::size_t i = 0; i < es.size(); ++i ) {
+            if ( i % 3u ) {
+                REQUIRE(es[i].find_component<anchor_c>() == ptrs[i]);
+                REQUIRE(ptrs[i]->x == static_cast<int>(i));
+                REQUIRE(es[i].assign_component<anchor_c>(anchor_c{1, 2}).x == 1);
+                REQUIRE(&es[i].get_component<anchor_c>() == ptrs[i]);
+            }
+        }
+        REQUIRE(w.component_count<anchor_c>() == 3000u);
+
+        std::size_t count = 0u;
+        w.for_joined_components<anchor_c, position_c>([&count](
+            ecs::entity e, const anchor_c& a, const position_c& p)
+        {
+            REQUIRE(a.x == 1);
+            REQUIRE(e.get_component<position_c>().x == p.x);
+            ++count;
+        });
+        REQUIRE(count == 2000u);
+
+        REQUIRE(w.remove_all_components<anchor_c>() == 3000u);
+        REQUIRE(w.component_count<anchor_c>() == 0u);
+    }
+    SUBCASE("shared_components") {
+        {
+            ecs::registry w;
+            static_assert(std::is_same_v<ecs::component_reference<sprite_c>, const sprite_c&>);
+
+            const auto p1 = ecs::prototype()
+                .component<sprite_c>(sprite_c{7, 1})
+                .component<position_c>(1, 2);
+            const ecs::compiled_prototype cp1(w, p1);
+
+            ecs::entity e1 = w.create_entity(p1);
+            ecs::entity e2 = w.create_entity(p1);
+            const std::vector<ecs::entity> es = w.create_entities(cp1, 100u);
+            ecs::entity e3 = w.create_entity(e1);
+
+            // the prototypes and the clones hold one instance
+            REQUIRE(&e1.get_component<sprite_c>() == &e2.get_component<sprite_c>());
+            REQUIRE(&e1.get_component<sprite_c>() == &es[99].get_component<sprite_c>());
+            REQUIRE(&e1.get_component<sprite_c>() == &e3.get_component<sprite_c>());
+            REQUIRE(w.component_use_count<sprite_c>(e1) == 105u);
+            REQUIRE(w.component_use_count<position_c>(e1) == 1u);
+
+            // copy on write
+            sprite_c& s1 = w.detach_component<sprite_c>(e1);
+            s1.frame = 2;
+            REQUIRE(w.component_use_count<sprite_c>(e1) == 1u);
+            REQUIRE(w.component_use_count<sprite_c>(e2) == 104u);
+            REQUIRE(e1.get_component<sprite_c>().frame == 2);
+            REQUIRE(e2.get_component<sprite_c>().frame == 1);
+            REQUIRE(&w.detach_component<sprite_c>(e1) == &s1);
+
+            // a jointly owned instance is replaced by assignment
+            e2.assign_component<sprite_c>(sprite_c{8, 0});
+            REQUIRE(e2.get_component<sprite_c>().texture == 8);
+            REQUIRE(e3.get_component<sprite_c>().texture == 7);
+            REQUIRE(w.component_use_count<sprite_c>(e3) == 103u);
+
+            w.share_component<sprite_c>(e2, e1);
+            REQUIRE(&e1.get_component<sprite_c>() == &e2.get_component<sprite_c>());
+            REQUIRE(w.component_use_count<sprite_c>(e1) == 2u);
+
+            ecs::entity e4 = w.create_entity();
+            w.share_component<sprite_c>(e4, e3);
+            w.share_component<position_c>(e4, e3);
+            REQUIRE(w.exists_all_components<sprite_c, position_c>(e4));
+            REQUIRE(&e4.get_component<sprite_c>() == &e3.get_component<sprite_c>());
+            REQUIRE(&e4.get_component<position_c>() != &e3.get_component<position_c>());
+            REQUIRE_THROWS_AS(w.share_component<sprite_c>(e1, w.create_entity()), std::logic_error);
+
+            std::size_t count = 0u;
+            w.for_joined_components<sprite_c, position_c>([&count](
+                const ecs::entity&, const sprite_c& s, const position_c& p)
+            {
+                REQUIRE((s.texture == 7 || s.frame == 2));
+                REQUIRE(p == position_c(1, 2));
+                ++count;
+            });
+            REQUIRE(count == 104u);
+
+            // the prototypes hold the instance too
+            w.destroy_entities(es.begin(), es.end());
+            REQUIRE(w.component_use_count<sprite_c>(e3) == 4u);
+            REQUIRE(e4.remove_component<sprite_c>());
+            REQUIRE(w.component_use_count<sprite_c>(e3) == 3u);
+        }
+        {
+            ecs::registry w(ecs::registry_backend::archetype);
+
+            const auto p1 = ecs::prototype()
+                .component<sprite_c>(sprite_c{7, 1});
+            ecs::entity e1 = w.create_entity(p1);
+            ecs::entity e2 = w.create_entity(ecs::compiled_prototype(w, p1));
+
+            // archetype tables keep a copy per entity
+            REQUIRE(w.component_use_count<sprite_c>(e1) == 1u);
+            REQUIRE(&e1.get_component<sprite_c>() != &e2.get_component<sprite_c>());
+            w.detach_component<sprite_c>(e1).frame = 2;
+            REQUIRE(e1.get_component<sprite_c>().frame == 2);
+            REQUIRE(e2.get_component<sprite_c>().frame == 1);
+            REQUIRE(w.share_component<sprite_c>(e2, e1).frame == 2);
+        }
+    }
+    SUBCASE("archetype_backend") {
+        {
+            ecs::registry w(ecs::registry_backend::archetype);
+            REQUIRE(w.backend() == ecs::registry_backend::archetype);
+            REQUIRE(ecs::registry().backend() == ecs::registry_backend::sparse);
+
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+            auto e3 = w.create_entity();
+
+            REQUIRE(e1.assign_component<position_c>(1, 2).x == 1);
+            REQUIRE(e1.assign_component<position_c>(3, 4).x == 3);
+            REQUIRE(e1.ensure_component<position_c>(5, 6).x == 3);
+            e1.assign_component<velocity_c>(5, 6);
+            e1.assign_component<movable_c>();
+            e2.assign_component<position_c>(7, 8);
+            e3.assign_component<velocity_c>(9, 10);
+            e3.assign_component<position_c>(11, 12);
+
+            REQUIRE(e1.get_component<position_c>() == position_c(3, 4));
+            REQUIRE(e3.get_component<velocity_c>() == velocity_c(9, 10));
+            REQUIRE(e1.exists_component<movable_c>());
+            REQUIRE_FALSE(e2.exists_component<velocity_c>());
+            REQUIRE_FALSE(e2.find_component<velocity_c>());
+            REQUIRE_FALSE(std::as_const(e2).find_component<velocity_c>());
+            REQUIRE(e1.component_count() == 3u);
+            REQUIRE(w.component_count<position_c>() == 3u);
+            REQUIRE(w.component_count<velocity_c>() == 2u);
+            REQUIRE(w.component_count<disabled_c>() == 0u);
+
+            std::vector<ecs::entity_id> ids;
+            w.for_joined_components<position_c, velocity_c>([&ids](
+                ecs::entity e, position_c& p, const velocity_c& v)
+            {
+                p.x = v.x;
+                ids.push_back(e.id());
+            }, !ecs::exists<movable_c>{});
+            REQUIRE(ids == std::vector<ecs::entity_id>{e3.id()});
+            REQUIRE(e3.get_component<position_c>().x == 9);
+
+            int sum = 0;
+            std::as_const(w).for_each_component<position_c>([&sum](
+                ecs::const_entity, const position_c& p)
+            {
+                sum += p.x;
+            });
+            REQUIRE(sum == 3 + 7 + 9);
+
+            REQUIRE(e1.remove_component<velocity_c>());
+            REQUIRE_FALSE(e1.remove_component<velocity_c>());
+            REQUIRE(e1.get_component<position_c>() == position_c(3, 4));
+            REQUIRE(e1.exists_component<movable_c>());
+            REQUIRE(e3.get_component<velocity_c>() == velocity_c(9, 10));
+
+            auto e4 = w.create_entity(e3);
+            REQUIRE(e4.get_component<position_c>() == position_c(9, 12));
+            REQUIRE(e4.get_component<velocity_c>() == velocity_c(9, 10));
+            REQUIRE(w.component_count<velocity_c>() == 2u);
+
+            e3.destroy();
+            REQUIRE(e4.get_component<velocity_c>() == velocity_c(9, 10));
+            REQUIRE(w.remove_all_components<position_c>() == 3u);
+            REQUIRE(w.component_count<position_c>() == 0u);
+            REQUIRE(e4.get_component<velocity_c>() == velocity_c(9, 10));
+            REQUIRE(e1.component_count() == 1u);
+            REQUIRE(e2.component_count() == 0u);
+
+            REQUIRE(w.memory_usage().components > 0u);
+            REQUIRE(w.component_memory_usage<velocity_c>() >= sizeof(velocity_c));
+        }
+        {
+            ecs::registry w(ecs::registry_backend::archetype);
+            REQUIRE_NOTHROW(w.group<position_c, velocity_c>());
+
+            auto e1 = w.create_entity(ecs::prototype()
+                .component<position_c>(1, 2)
+                .component<transform_c>(3, 4, 5));
+
+            REQUIRE(e1.get_component<position_c>() == position_c(1, 2));
+            REQUIRE(e1.get_component<transform_c>().get<2>() == 5);
+
+            w.for_joined_components<transform_c, position_c>([](
+                ecs::entity, ecs::soa_reference<transform_c> t, position_c& p)
+            {
+                t.get<0>() = p.y;
+            });
+            REQUIRE(e1.get_component<transform_c>().load().x == 2);
+        }
+    }
+    SUBCASE("memory_resources") {
+        struct counting_tag {};
+        struct counting_system : ecs::system<int> {
+            void process(ecs::registry&, const int&) override {}
+        };
+        counting_resource r;
+        {
+            ecs::registry w(&r);
+            REQUIRE(w.resource() == &r);
+            REQUIRE(ecs::registry().resource() == ecs::new_delete_resource());
+
+            w.group<position_c, velocity_c>();
+            w.assign_feature<counting_tag>().add_system<counting_system>();
+
+            const std::size_t allocations = r.allocations();
+            auto e1 = w.create_entity();
+            e1.assign_component<position_c>(1, 2);
+            e1.assign_component<velocity_c>(3, 4);
+            e1.assign_component<movable_c>();
+            e1.assign_component<transform_c>(transform_c{1, 2, 3});
+            e1.assign_component<anchor_c>(anchor_c{4, 5});
+            REQUIRE(r.allocations() > allocations);
+
+            ecs::prototype p(&r);
+            p.component<position_c>(5, 6);
+            REQUIRE(p.resource() == &r);
+            REQUIRE(ecs::prototype(p).resource() == &r);
+            REQUIRE(ecs::prototype().resource() == ecs::new_delete_resource());
+
+            auto e2 = w.create_entity(p);
+            REQUIRE(e2.get_component<position_c>() == position_c(5, 6));
+            e1.destroy();
+            w.process_event(42);
+        }
+        REQUIRE(r.allocated_bytes() == 0u);
+        {
+            ecs::registry w(ecs::registry_backend::archetype, &r);
+            REQUIRE(w.resource() == &r);
+
+            const std::size_t allocations = r.allocations();
+            auto e1 = w.create_entity();
+            e1.assign_component<position_c>(1, 2);
+            e1.assign_component<transform_c>(transform_c{1, 2, 3});
+            REQUIRE(r.allocations() > allocations);
+
+            auto e2 = w.create_entity(e1);
+            REQUIRE(e2.get_component<position_c>() == position_c(1, 2));
+            REQUIRE(e1.remove_component<position_c>());
+        }
+        REQUIRE(r.allocated_bytes() == 0u);
+        {
+            ecs::registry w(&r);
+            w.create_entity().assign_component<position_c>(1, 2);
+            ecs::registry w2(std::move(w));
+            REQUIRE(w2.resource() == &r);
+            REQUIRE(w2.component_count<position_c>() == 1u);
+        }
+        REQUIRE(r.allocated_bytes() == 0u);
+    }
+    SUBCASE("signatures") {
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+
+            assign_numbered_components(e1, false, std::make_index_sequence<70>());
+            assign_numbered_components(e2, true, std::make_index_sequence<70>());
+
+            REQUIRE(e1.component_count() == 70u);
+            REQUIRE(e2.component_count() == 35u);
+            REQUIRE(e1.get_component<numbered_c<69>>().value == 69u);
+            REQUIRE(w.exists_all_components<numbered_c<1>, numbered_c<69>>(e2));
+            REQUIRE_FALSE(w.exists_all_components<numbered_c<1>, numbered_c<68>>(e2));
+            REQUIRE(w.exists_any_components<numbered_c<0>, numbered_c<67>>(e2));
+            REQUIRE_FALSE(w.exists_any_components<numbered_c<0>, position_c>(e2));
+            REQUIRE(w.exists_all_components<>(e2));
+            REQUIRE_FALSE(w.exists_any_components<>(e2));
+
+            auto e3 = w.create_entity(e2);
+            REQUIRE(e3.component_count() == 35u);
+            REQUIRE(e3.exists_component<numbered_c<69>>());
+            REQUIRE_FALSE(e3.exists_component<numbered_c<68>>());
+
+            REQUIRE(e2.remove_component<numbered_c<69>>());
+            REQUIRE_FALSE(e2.remove_component<numbered_c<69>>());
+            REQUIRE(e2.component_count() == 34u);
+            REQUIRE_FALSE(w.exists_all_components<numbered_c<69>>(e2));
+
+            REQUIRE(w.remove_all_components<numbered_c<1>>() == 3u);
+            REQUIRE(e1.component_count() == 69u);
+            REQUIRE(e3.component_count() == 34u);
+
+            REQUIRE(e1.remove_all_components() == 69u);
+            REQUIRE(e1.component_count() == 0u);
+            REQUIRE(e3.exists_component<numbered_c<3>>());
+
+            e3.destroy();
+            auto e4 = w.create_entity();
+            REQUIRE(e4.component_count() == 0u);
+            REQUIRE_FALSE(e4.exists_component<numbered_c<3>>());
+        }
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            e1.assign_component<position_c>();
+            e1.assign_component<movable_c>();
+
+            REQUIRE(ecs::exists_all<position_c, movable_c>{}(e1));
+            REQUIRE_FALSE(ecs::exists_all<position_c, velocity_c>{}(e1));
+            REQUIRE(ecs::exists_any<velocity_c, movable_c>{}(e1));
+            REQUIRE(ecs::aspect<position_c, movable_c>::match_entity(e1));
+        }
+    }
+    SUBCASE("storage_slots") {
+        {
+            // registries with different storage orders share the slot hints
+            ecs::registry w1;
+            ecs::registry w2;
+            auto e1 = w1.create_entity();
+            auto e2 = w2.create_entity();
+
+            e1.assign_component<position_c>(1, 2);
+            e1.assign_component<velocity_c>(3, 4);
+            e2.assign_component<velocity_c>(5, 6);
+            e2.assign_component<position_c>(7, 8);
+
+            for ( std::size_t i = 0; i < 2; ++i ) {
+                REQUIRE(e1.get_component<position_c>() == position_c(1, 2));
+                REQUIRE(e1.get_component<velocity_c>() == velocity_c(3, 4));
+                REQUIRE(e2.get_component<position_c>() == position_c(7, 8));
+                REQUIRE(e2.get_component<velocity_c>() == velocity_c(5, 6));
+                REQUIRE_FALSE(e1.find_component<movable_c>());
+                REQUIRE_FALSE(e2.find_component<movable_c>());
+            }
+
+            REQUIRE(w1.component_count<position_c>() == 1u);
+            REQUIRE(w2.component_count<velocity_c>() == 1u);
+            REQUIRE_FALSE(w2.component_count<movable_c>());
+        }
+    }
+    SUBCASE("aspects") {
+        {
+            using empty_aspect = ecs::aspect<>;
+
+            ecs::registry w;
+
+            ecs::entity e1 = w.create_entity();
+            REQUIRE(empty_aspect::match_entity(e1));
+
+            ecs::entity e2 = w.create_entity();
+            e2.assign_component<movable_c>();
+            e2.assign_component<position_c>(1,2);
+            REQUIRE(empty_aspect::match_entity(e2));
+
+            ecs::entity e3 = w.create_entity();
+            e3.assign_component<movable_c>();
+            e3.assign_component<position_c>(1,2);
+            e3.assign_component<velocity_c>(3,4);
+            REQUIRE(empty_aspect::match_entity(e3));
+
+            {
+                ecs::entity_id acc{};
+                empty_aspect::for_each_entity(w, [&acc](ecs::entity e){
                     acc += e.id();
                 }, ecs::exists<movable_c>{});
                 REQUIRE(acc == e2.id() + e3.id());
@@ -1652,6 +3172,11 @@ TEST_CASE("registry") {
         }
     }
     SUBCASE("memory_usage") {
+        using sparse_index_t = ecs::detail::entity_id_sparse_index;
+        using sparse_pages_t = ecs::detail::sparse_pages<sparse_index_t>;
+        const std::size_t sparse_page_usage =
+            sizeof(std::unique_ptr<sparse_index_t[]>) +        // sparse page table
+            sparse_pages_t::page_size * sizeof(sparse_index_t); // sparse page
         {
             ecs::registry w;
             REQUIRE(w.memory_usage().entities == 0u);
@@ -1660,9 +3185,8 @@ TEST_CASE("registry") {
             auto e2 = w.create_entity();
 
             const std::size_t expected_usage =
-                2 * sizeof(ecs::entity_id) + // vector free entity ids
-                4 * sizeof(std::size_t) +    // sparse entity ids (keys)
-                2 * sizeof(ecs::entity_id);  // sparse entity ids (values)
+                sizeof(ecs::entity_id*) +  // entity slot page table
+                sparse_pages_t::page_size * sizeof(ecs::entity_id); // entity slot page
             REQUIRE(w.memory_usage().entities == expected_usage);
 
             e1.destroy();
@@ -1684,13 +3208,13 @@ TEST_CASE("registry") {
 
             const std::size_t expected_usage =
                 2 * sizeof(position_c) +    // vector values
-                4 * sizeof(std::size_t) +   // sparse keys (keys)
+                sparse_page_usage +         // sparse keys (keys)
                 2 * sizeof(ecs::entity_id); // sparse keys (values)
             REQUIRE(w.memory_usage().components == expected_usage);
 
             REQUIRE(w.component_memory_usage<position_c>() ==
                 2 * sizeof(position_c) +
-                4 * sizeof(std::size_t) +
+                sparse_page_usage +
                 2 * sizeof(ecs::entity_id));
 
             REQUIRE_FALSE(w.component_memory_usage<velocity_c>());
@@ -1706,21 +3230,21 @@ TEST_CASE("registry") {
 
             const std::size_t expected_usage =
                 sizeof(position_c) +
-                2 * sizeof(std::size_t) +
+                sparse_page_usage +
                 1 * sizeof(ecs::entity_id) +
                 sizeof(velocity_c) +
-                3 * sizeof(std::size_t) +
+                sparse_page_usage +
                 1 * sizeof(ecs::entity_id);
             REQUIRE(w.memory_usage().components == expected_usage);
 
             REQUIRE(w.component_memory_usage<position_c>() ==
                 sizeof(position_c) +
-                2 * sizeof(std::size_t) +
+                sparse_page_usage +
                 1 * sizeof(ecs::entity_id));
 
             REQUIRE(w.component_memory_usage<velocity_c>() ==
                 sizeof(velocity_c) +
-                3 * sizeof(std::size_t) +
+                sparse_page_usage +
                 1 * sizeof(ecs::entity_id));
         }
         {
@@ -1730,8 +3254,187 @@ TEST_CASE("registry") {
             e1.assign_component<movable_c>();
             e2.assign_component<movable_c>();
             REQUIRE(w.component_memory_usage<movable_c>() ==
-                4 * sizeof(std::size_t) +
-                2 * sizeof(ecs::entity_id));
+                sizeof(std::uint64_t) + // bitset words
+                sizeof(std::uint64_t)); // bitset summary
+        }
+    }
+    SUBCASE("growth_policies") {
+        const auto capacities = [](const recording_observer& o, ecs::family_id family){
+            std::vector<std::size_t> result;
+            for ( const ecs::growth_event& e : o.events ) {
+                if ( e.family == family ) {
+                    result.push_back(e.new_capacity);
+                }
+            }
+            return result;
+        };
+        {
+            recording_observer o;
+            ecs::registry w;
+            w.set_growth_observer(&o);
+            w.set_growth_policy({ecs::growth_mode::one_and_half, 0u});
+            w.set_growth_policy<position_c>({ecs::growth_mode::fixed_step, 100u});
+            w.set_growth_policy<velocity_c>({ecs::growth_mode::reserved, 1000u});
+
+            for ( int i = 0; i < 250; ++i ) {
+                auto e = w.create_entity();
+                e.assign_component<position_c>(i, i);
+                e.assign_component<velocity_c>(i, i);
+                e.assign_component<transform_c>(i, i, i);
+            }
+
+            const ecs::family_id position_family = ecs::detail::type_family<position_c>::id();
+            const ecs::family_id velocity_family = ecs::detail::type_family<velocity_c>::id();
+            const ecs::family_id transform_family = ecs::detail::type_family<transform_c>::id();
+            REQUIRE(capacities(o, position_family) == std::vector<std::size_t>{100u, 200u, 300u});
+            REQUIRE(capacities(o, velocity_family) == std::vector<std::size_t>{1000u});
+            const std::vector<std::size_t> transform_capacities = capacities(o, transform_family);
+            REQUIRE(transform_capacities.size() > 4u);
+            REQUIRE(std::vector<std::size_t>(transform_capacities.begin(), transform_capacities.begin() + 4)
+                == std::vector<std::size_t>{2u, 3u, 4u, 6u});
+            REQUIRE_FALSE(capacities(o, 0u).empty());
+
+            const auto position_event = std::find_if(o.events.begin(), o.events.end(),
+                [position_family](const ecs::growth_event& e){ return e.family == position_family; });
+            REQUIRE(position_event->element_size == sizeof(position_c));
+            REQUIRE(position_event->old_capacity == 0u);
+
+            // custom policies are kept by the registry ones
+            w.set_growth_policy({ecs::growth_mode::doubling, 0u});
+            o.events.clear();
+            for ( int i = 0; i < 60; ++i ) {
+                w.create_entity().assign_component<position_c>(i, i);
+            }
+            REQUIRE(capacities(o, position_family) == std::vector<std::size_t>{400u});
+
+            w.set_growth_observer(nullptr);
+            o.events.clear();
+            for ( int i = 0; i < 100; ++i ) {
+                w.create_entity().assign_component<position_c>(i, i);
+            }
+            REQUIRE(o.events.empty());
+        }
+        {
+            ecs::registry w;
+            w.set_growth_policy<position_c>({ecs::growth_mode::fixed_step, 1u});
+            auto e1 = w.create_entity();
+            auto e2 = w.create_entity();
+            e1.assign_component<position_c>(1, 2);
+            // the source component may be moved by a reallocation
+            e2.assign_component<position_c>(e1.get_component<position_c>());
+            REQUIRE(e2.get_component<position_c>() == position_c(1, 2));
+            e1.remove_component<position_c>();
+            REQUIRE(w.compact() == 0u);
+        }
+        {
+            recording_observer o;
+            ecs::registry w(ecs::registry_backend::archetype);
+            w.set_growth_observer(&o);
+            w.set_growth_policy({ecs::growth_mode::fixed_step, 10u});
+            for ( int i = 0; i < 25; ++i ) {
+                w.create_entity().assign_component<position_c>(i, i);
+            }
+            REQUIRE(capacities(o, 0u) == std::vector<std::size_t>{10u, 20u, 30u});
+            REQUIRE(o.events[0].element_size == sizeof(ecs::entity_id) + sizeof(position_c));
+        }
+    }
+    SUBCASE("shrinking") {
+        {
+            ecs::registry w;
+            std::vector<ecs::entity> es;
+            for ( int i = 0; i < 3000; ++i ) {
+                es.push_back(w.create_entity());
+                ecs::entity_filler(es.back())
+                    .component<position_c>(i, i)
+                    .component<movable_c>()
+                    .component<transform_c>(i, i, i)
+                    .component<anchor_c>(i, i);
+            }
+            for ( std::size_t i = 3u; i < es.size(); ++i ) {
+                es[i].destroy();
+            }
+
+            const std::size_t usage = w.memory_usage().components;
+            const std::size_t position_usage = w.component_memory_usage<position_c>();
+            w.shrink_to_fit<position_c>();
+            REQUIRE(w.component_memory_usage<position_c>() < position_usage);
+            REQUIRE(w.memory_usage().components < usage);
+
+            w.shrink_to_fit();
+            REQUIRE(w.component_memory_usage<movable_c>() == 2 * sizeof(std::uint64_t));
+            REQUIRE(w.component_memory_usage<anchor_c>() < position_usage);
+            for ( int i = 0; i < 3; ++i ) {
+                const auto& e = es[static_cast<std::size_t>(i)];
+                REQUIRE(e.get_component<position_c>() == position_c(i, i));
+                REQUIRE(e.exists_component<movable_c>());
+                REQUIRE(e.get_component<transform_c>().get<2>() == i);
+                REQUIRE(e.get_component<anchor_c>().y == i);
+            }
+            REQUIRE(w.create_entity().assign_component<anchor_c>(7, 7).x == 7);
+        }
+        {
+            ecs::registry w;
+            auto e1 = w.create_entity();
+            e1.assign_component<position_c>(1, 2);
+            e1.assign_component<velocity_c>(3, 4);
+            e1.assign_component<movable_c>();
+            w.group<position_c, velocity_c>();
+
+            e1.remove_all_components();
+            REQUIRE(w.compact() == 1u);
+            REQUIRE(w.compact() == 0u);
+            REQUIRE_FALSE(w.component_count<movable_c>());
+            REQUIRE_FALSE(w.component_memory_usage<movable_c>());
+            REQUIRE_FALSE(e1.exists_component<movable_c>());
+            REQUIRE_FALSE(w.remove_all_components<movable_c>());
+
+            auto e2 = w.create_entity();
+            e2.assign_component<movable_c>();
+            e2.assign_component<position_c>(5, 6);
+            REQUIRE(e2.exists_component<movable_c>());
+            REQUIRE(e2.component_count() == 2u);
+            REQUIRE(w.exists_all_components<movable_c, position_c>(e2));
+            REQUIRE_FALSE(e1.exists_component<movable_c>());
+        }
+        {
+            ecs::registry w;
+            REQUIRE(w.shrink_policy().min_occupancy == 0.0);
+            w.set_shrink_policy({0.25, 64u});
+            REQUIRE(w.shrink_policy().min_capacity == 64u);
+
+            std::vector<ecs::entity> es;
+            for ( int i = 0; i < 1000; ++i ) {
+                es.push_back(w.create_entity());
+                es.back().assign_component<position_c>(i, i);
+            }
+            const std::size_t usage = w.component_memory_usage<position_c>();
+            for ( std::size_t i = 0; i < 990u; ++i ) {
+                es[i].destroy();
+            }
+            // the sparse page of the left entities is still in use
+            REQUIRE(w.component_memory_usage<position_c>() < usage / 2u);
+            for ( std::size_t i = 990u; i < es.size(); ++i ) {
+                REQUIRE(es[i].get_component<position_c>().x == static_cast<int>(i));
+            }
+
+            es[995].remove_component<position_c>();
+            REQUIRE(w.remove_all_components<position_c>() == 9u);
+        }
+        {
+            ecs::registry w(ecs::registry_backend::archetype);
+            std::vector<ecs::entity> es;
+            for ( int i = 0; i < 1000; ++i ) {
+                es.push_back(w.create_entity());
+                es.back().assign_component<position_c>(i, i);
+            }
+            for ( std::size_t i = 1u; i < es.size(); ++i ) {
+                es[i].destroy();
+            }
+            const std::size_t usage = w.memory_usage().components;
+            w.shrink_to_fit();
+            REQUIRE(w.memory_usage().components < usage);
+            REQUIRE(es[0].get_component<position_c>().x == 0);
+            REQUIRE(w.compact() == 0u);
         }
     }
     SUBCASE("empty_component") {
@@ -1746,5 +3449,23 @@ TEST_CASE("registry") {
         w.for_joined_components<movable_c, position_c>([
         ](const ecs::const_entity&, movable_c&, position_c&){
         });
+
+        auto e2 = w.create_entity();
+        e2.assign_component<movable_c>();
+        e2.destroy();
+        e2 = w.create_entity();
+        REQUIRE_FALSE(e2.exists_component<movable_c>());
+        e2.assign_component<movable_c>();
+        REQUIRE(w.component_count<movable_c>() == 2u);
+
+        std::vector<ecs::entity_id> ids;
+        std::as_const(w).for_each_component<movable_c>([&ids](ecs::const_entity e, const movable_c&){
+            ids.push_back(e.id());
+        });
+        REQUIRE(ids == std::vector<ecs::entity_id>{e1.id(), e2.id()});
+
+        REQUIRE(w.remove_all_components<movable_c>() == 2u);
+        REQUIRE_FALSE(e1.exists_component<movable_c>());
+        REQUIRE(w.component_count<movable_c>() == 0u);
     }
 }